@@ -0,0 +1,362 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "csr_matrix.h"
+#include "matrix_io.h"
+#include "kernel_registry.h"
+#include "reorder.h"
+#include "bcsr.h"
+
+// ---------------------------------------------------------------------------
+// Matrix features, kernel selection and tuned plans
+// ---------------------------------------------------------------------------
+//
+// analyze_matrix() summarises the structure of a CSR matrix: row-length
+// statistics (mean, variance, max, Gini coefficient), bandwidth, the best
+// estimated BCSR block fill and the footprint of the input vector. From
+// these, tune_candidates() keeps the registered kernels that can pay off
+// on the matrix (e.g. merge path / stealing only for skewed rows, BCSR only
+// when a block size beats CSR traffic, tiled only when v_in does not fit
+// the last-level cache) and tune_plan() times each of them with a few trial
+// SpMVs over a range of thread counts and OpenMP schedules.
+//
+// The winner is stored as a TunedPlan next to the matrix
+// ("cage14.mtx" -> "cage14.plan"), tied to the source file like the binary
+// CSR cache and to the host, thread budget and reordering it was tuned for,
+// so later runs on the same matrix skip the tuning.
+
+struct MatrixFeatures {
+    int rows = 0;
+    int cols = 0;
+    long long nnz = 0;
+    double row_mean = 0.0;       // nonzeros per row
+    double row_variance = 0.0;
+    int row_max = 0;
+    int empty_rows = 0;
+    double row_gini = 0.0;       // 0: all rows equally long, -> 1: few rows hold all
+    long long bandwidth = 0;     // max |i - j|
+    int block_r = 1;             // best estimated BCSR block (choose_bcsr_block)
+    int block_c = 1;
+    double block_fill = 1.0;     // its stored / nnz
+    double block_bytes_per_nnz = 12.0;
+    double x_bytes = 0.0;        // footprint of v_in
+};
+
+inline void analyze_matrix(const CsrMatrix& A, MatrixFeatures& f) {
+    f.rows = A.rows;
+    f.cols = A.cols;
+    f.nnz  = A.nnz;
+
+    std::vector<int> lengths(A.rows);
+    double sum = 0.0, sum_sq = 0.0;
+    int row_max = 0, empty = 0;
+    for (int i = 0; i < A.rows; ++i) {
+        const int len = A.row_ptr[i + 1] - A.row_ptr[i];
+        lengths[i] = len;
+        sum    += len;
+        sum_sq += (double)len * len;
+        row_max = std::max(row_max, len);
+        if (len == 0) ++empty;
+    }
+    const double n = std::max(1, A.rows);
+    f.row_mean     = sum / n;
+    f.row_variance = std::max(0.0, sum_sq / n - f.row_mean * f.row_mean);
+    f.row_max      = row_max;
+    f.empty_rows   = empty;
+
+    // Gini over the sorted row lengths x_1 <= ... <= x_n:
+    // G = 2 sum_k k x_k / (n sum_k x_k) - (n + 1) / n
+    std::sort(lengths.begin(), lengths.end());
+    double weighted = 0.0;
+    for (int k = 0; k < A.rows; ++k) weighted += (k + 1.0) * lengths[k];
+    f.row_gini = sum > 0.0 ? 2.0 * weighted / (n * sum) - (n + 1.0) / n : 0.0;
+
+    long long profile = 0;
+    csr_bandwidth_profile(A, f.bandwidth, profile);
+
+    const BcsrBlockEstimate best = choose_bcsr_block(A);
+    f.block_r             = best.R;
+    f.block_c             = best.C;
+    f.block_fill          = best.fill;
+    f.block_bytes_per_nnz = best.bytes_per_nnz;
+    f.x_bytes             = 8.0 * A.cols;
+}
+
+inline void print_matrix_features(std::ostream& out, const MatrixFeatures& f) {
+    out << "Features: " << f.rows << " x " << f.cols << ", " << f.nnz << " nnz; rows mean "
+        << f.row_mean << ", stddev " << std::sqrt(f.row_variance) << ", max " << f.row_max
+        << ", empty " << f.empty_rows << ", Gini " << f.row_gini << "; bandwidth "
+        << f.bandwidth << "; BCSR " << f.block_r << "x" << f.block_c << " fill "
+        << f.block_fill << " (" << f.block_bytes_per_nnz << " B/nnz); v_in "
+        << f.x_bytes / 1024.0 << " KB\n";
+}
+
+// Size of the largest CPU cache reported by sysfs (32 MB if unknown)
+inline double last_level_cache_bytes() {
+    double best = 0.0;
+    for (int index = 0; index < 8; ++index) {
+        std::ifstream in(("/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) +
+                          "/size").c_str());
+        double size = 0.0;
+        char unit = 0;
+        if (!(in >> size)) continue;
+        in >> unit;
+        if (unit == 'K') size *= 1024.0;
+        if (unit == 'M') size *= 1048576.0;
+        best = std::max(best, size);
+    }
+    return best > 0.0 ? best : 32.0 * 1048576.0;
+}
+
+// A kernel with the OpenMP schedule it is tried with
+struct TuneCandidate {
+    std::string kernel;
+    std::string schedule;
+};
+
+// Kernels worth trying on a matrix with features f. The runtime-schedule
+// engines get dynamic and guided as well when the rows are skewed; the
+// work-split engines ignore the schedule and are tried once.
+inline void tune_candidates(const MatrixFeatures& f, std::vector<TuneCandidate>& out) {
+    const double cv     = f.row_mean > 0.0 ? std::sqrt(f.row_variance) / f.row_mean : 0.0;
+    const bool skewed   = f.row_gini > 0.3 || f.row_max > 10.0 * std::max(1.0, f.row_mean);
+    const double llc    = last_level_cache_bytes();
+    const double matrix = 4.0 * (f.rows + 1) + 12.0 * f.nnz;
+
+    std::vector<std::string> runtime, split;
+    runtime.push_back("csr");
+    split.push_back("csr-balanced");
+    if (skewed) {
+        split.push_back("csr-merge");
+        split.push_back("csr-steal");
+    }
+    if (matrix < llc) split.push_back("csr-persistent");   // fork/join dominates
+    if (cv <= 1.0) runtime.push_back("sell");               // padding stays modest
+    if (f.block_bytes_per_nnz < 12.0) runtime.push_back("bcsr");
+    if (f.bandwidth < 65536) runtime.push_back("csr-delta");      // 2-byte column gaps
+    if (f.x_bytes > llc / 2) runtime.push_back("tiled");
+
+    out.clear();
+    for (size_t k = 0; k < runtime.size(); ++k) {
+        TuneCandidate c = {runtime[k], "static"};
+        out.push_back(c);
+        if (skewed) {
+            c.schedule = "dynamic";
+            out.push_back(c);
+            c.schedule = "guided";
+            out.push_back(c);
+        }
+    }
+    for (size_t k = 0; k < split.size(); ++k) {
+        TuneCandidate c = {split[k], "static"};
+        out.push_back(c);
+    }
+}
+
+struct TunedPlan {
+    std::string kernel;          // registry name
+    std::string schedule;        // static, dynamic, guided
+    int chunk   = 0;
+    int threads = 1;
+    KernelOptions options;       // as resolved by the engine (block, tile width)
+    double ms   = 0.0;           // best trial time
+};
+
+inline bool tune_set_schedule(const std::string& schedule, int chunk, int threads) {
+#ifdef _OPENMP
+    omp_sched_t kind = omp_sched_static;
+    if (schedule == "dynamic") {
+        kind = omp_sched_dynamic;
+    } else if (schedule == "guided") {
+        kind = omp_sched_guided;
+    } else if (schedule != "static") {
+        return false;
+    }
+    omp_set_num_threads(threads);
+    omp_set_schedule(kind, chunk);
+    return true;
+#else
+    (void)chunk;
+    (void)threads;
+    return schedule == "static" || schedule == "dynamic" || schedule == "guided";
+#endif
+}
+
+// Try every candidate with 1, 2, 4, ... max_threads threads (and
+// max_threads itself) on the input vector v: one warm-up and TRIAL_RUNS
+// timed calls each, the fastest call counts. Leaves the OpenMP settings of
+// the last trial in place.
+inline bool tune_plan(const CsrMatrix& A, const std::vector<TuneCandidate>& candidates,
+                      int max_threads, int chunk, const KernelOptions& base,
+                      const std::vector<double>& v, TunedPlan& plan) {
+    const int TRIAL_RUNS = 5;
+
+    std::vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    std::vector<double> c(A.rows);
+    bool found = false;
+    for (size_t t = 0; t < thread_counts.size(); ++t) {
+        for (size_t k = 0; k < candidates.size(); ++k) {
+            const KernelEntry* entry = find_kernel(candidates[k].kernel);
+            if (!entry || !tune_set_schedule(candidates[k].schedule, chunk, thread_counts[t])) {
+                continue;
+            }
+            KernelOptions opts = base;
+            opts.threads = thread_counts[t];
+            opts.chunk   = chunk;
+            std::unique_ptr<SpmvEngine> engine = entry->create(A, opts);
+            if (!engine) continue;
+
+            engine->multiply(v, c);   // warm-up
+            double ms = 0.0;
+            for (int run = 0; run < TRIAL_RUNS; ++run) {
+                const std::chrono::steady_clock::time_point start =
+                    std::chrono::steady_clock::now();
+                engine->multiply(v, c);
+                const double run_ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+                ms = (run == 0) ? run_ms : std::min(ms, run_ms);
+            }
+            std::cerr << "  " << engine->label() << ":" << candidates[k].schedule << " "
+                      << thread_counts[t] << " threads: " << ms << " ms\n";
+
+            if (!found || ms < plan.ms) {
+                found = true;
+                plan.kernel   = entry->name;
+                plan.schedule = candidates[k].schedule;
+                plan.chunk    = chunk;
+                plan.threads  = thread_counts[t];
+                plan.options  = opts;
+                plan.ms       = ms;
+                engine->resolved_options(plan.options);
+            }
+        }
+    }
+    return found;
+}
+
+// ---------------------------------------------------------------------------
+// Plan cache: a small "key value" text file per matrix
+// ---------------------------------------------------------------------------
+
+static const int TUNED_PLAN_VERSION = 2;
+
+// Example: "/home/.../cage14/cage14.mtx" -> "/home/.../cage14/cage14.plan"
+inline std::string tuned_plan_path(const std::string& mtx_path) {
+    const std::string cache = csr_cache_path(mtx_path);
+    return cache.substr(0, cache.size() - 4) + ".plan";
+}
+
+// What a plan is valid for: the source file, the host and the options that
+// shaped the tuning
+struct TunedPlanKey {
+    long long source_size = 0;
+    long long source_mtime = 0;
+    std::string host;
+    int max_threads = 0;
+    std::string reorder;
+};
+
+// Written under a temporary name and renamed into place, like the CSR
+// cache, so a concurrent job never reads a partial plan.
+inline bool write_tuned_plan(const std::string& path, const TunedPlanKey& key,
+                             const TunedPlan& plan) {
+    const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+    std::ofstream out(tmp_path.c_str());
+    if (!out) return false;
+    out << "version " << TUNED_PLAN_VERSION << "\n"
+        << "source_size " << key.source_size << "\n"
+        << "source_mtime " << key.source_mtime << "\n"
+        << "host " << key.host << "\n"
+        << "max_threads " << key.max_threads << "\n"
+        << "reorder " << key.reorder << "\n"
+        << "kernel " << plan.kernel << "\n"
+        << "schedule " << plan.schedule << "\n"
+        << "chunk " << plan.chunk << "\n"
+        << "threads " << plan.threads << "\n"
+        << "sell_c " << plan.options.sell_c << "\n"
+        << "sell_sigma " << plan.options.sell_sigma << "\n"
+        << "sell_isa " << sell_isa_name(plan.options.sell_isa) << "\n"
+        << "block " << plan.options.block_r << " " << plan.options.block_c << "\n"
+        << "tile_kb " << plan.options.tile_kb << "\n"
+        << "ms " << plan.ms << "\n";
+    out.close();
+    bool ok = static_cast<bool>(out);
+    ok = ok && std::rename(tmp_path.c_str(), path.c_str()) == 0;
+    if (!ok) std::remove(tmp_path.c_str());
+    return ok;
+}
+
+// False if there is no plan at path or it was tuned for something else
+inline bool read_tuned_plan(const std::string& path, const TunedPlanKey& key,
+                            TunedPlan& plan) {
+    std::ifstream in(path.c_str());
+    if (!in) return false;
+
+    TunedPlanKey found;
+    int version = 0;
+    std::string field;
+    while (in >> field) {
+        if (field == "version") {
+            in >> version;
+        } else if (field == "source_size") {
+            in >> found.source_size;
+        } else if (field == "source_mtime") {
+            in >> found.source_mtime;
+        } else if (field == "host") {
+            in >> found.host;
+        } else if (field == "max_threads") {
+            in >> found.max_threads;
+        } else if (field == "reorder") {
+            in >> found.reorder;
+        } else if (field == "kernel") {
+            in >> plan.kernel;
+        } else if (field == "schedule") {
+            in >> plan.schedule;
+        } else if (field == "chunk") {
+            in >> plan.chunk;
+        } else if (field == "threads") {
+            in >> plan.threads;
+        } else if (field == "sell_c") {
+            in >> plan.options.sell_c;
+        } else if (field == "sell_sigma") {
+            in >> plan.options.sell_sigma;
+        } else if (field == "sell_isa") {
+            std::string isa;
+            in >> isa;
+            if (in && !sell_isa_from_name(isa, plan.options.sell_isa)) return false;
+        } else if (field == "block") {
+            in >> plan.options.block_r >> plan.options.block_c;
+        } else if (field == "tile_kb") {
+            in >> plan.options.tile_kb;
+        } else if (field == "ms") {
+            in >> plan.ms;
+        } else {
+            return false;
+        }
+        if (!in) return false;
+    }
+    plan.options.threads = plan.threads;
+    plan.options.chunk   = plan.chunk;
+    return version == TUNED_PLAN_VERSION && found.source_size == key.source_size &&
+           found.source_mtime == key.source_mtime && found.host == key.host &&
+           found.max_threads == key.max_threads && found.reorder == key.reorder &&
+           find_kernel(plan.kernel) != nullptr && plan.threads > 0;
+}
+
+#endif // AUTOTUNE_H
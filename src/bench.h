@@ -0,0 +1,358 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Benchmark harness shared by spmv_seq, spmv and spmv_mpi
+// ---------------------------------------------------------------------------
+//
+// A benchmark is `warmup` untimed calls followed by at least `runs` timed
+// calls; with min_time_ms > 0 timed calls continue until their total
+// reaches min_time_ms, so short kernels are measured over many calls.
+// Times are wall-clock milliseconds per call (steady_clock, so the
+// sequential binary needs no OpenMP).
+//
+// Harness options (all binaries):
+//
+//   --warmup N      untimed calls before timing (default 1)
+//   --runs N        minimum number of timed calls (default 10)
+//   --min-time MS   keep timing until the timed calls add up to MS ms
+//   --report csv|json
+//                   self-describing report with statistics, GFLOP/s, GB/s
+//                   and build / host metadata instead of the legacy line
+//   --seed N        seed of the random input vector (default: random), so
+//                   separate processes multiply the same vector
+//   --verify        check the result of the timed calls against a Kahan
+//                   CSR reference (verify.h), outside the timed region
+//   --verify-tol T  tolerance of that check; implies --verify
+
+struct BenchOptions {
+    int warmup         = 1;
+    int runs           = 10;
+    double min_time_ms = 0.0;
+    std::string report;          // "" (legacy line), "csv" or "json"
+    bool seed_set      = false;
+    unsigned seed      = 0;
+    bool verify        = false;
+    double verify_tol  = 0.0;    // 0: default for the kernel precision
+};
+
+// Seed of the input vector: --seed if given, fallback otherwise
+inline unsigned bench_seed(const BenchOptions& opts, unsigned fallback) {
+    return opts.seed_set ? opts.seed : fallback;
+}
+
+// Handle argv[i] if it is a harness option (advancing i past its value).
+// Returns false if argv[i] is not a harness option; ok is set to false
+// (after printing an error) for a bad value.
+inline bool bench_parse_option(int argc, char* argv[], int& i, BenchOptions& opts, bool& ok) {
+    const std::string opt = argv[i];
+    if (opt == "--verify") {
+        opts.verify = true;
+        ok = true;
+        return true;
+    }
+    if ((opt != "--warmup" && opt != "--runs" && opt != "--min-time" && opt != "--report" &&
+         opt != "--seed" && opt != "--verify-tol") ||
+        i + 1 >= argc) {
+        return false;
+    }
+    const std::string value = argv[++i];
+    ok = true;
+    try {
+        size_t pos = 0;
+        if (opt == "--seed") {
+            const unsigned long long seed = std::stoull(value, &pos);
+            ok = pos == value.size() && value[0] != '-' && seed <= 0xffffffffULL;
+            opts.seed     = static_cast<unsigned>(seed);
+            opts.seed_set = true;
+        } else if (opt == "--verify-tol") {
+            opts.verify_tol = std::stod(value, &pos);
+            ok = pos == value.size() && opts.verify_tol > 0.0;
+            opts.verify = true;
+        } else if (opt == "--warmup") {
+            opts.warmup = std::stoi(value, &pos);
+            ok = pos == value.size() && opts.warmup >= 0;
+        } else if (opt == "--runs") {
+            opts.runs = std::stoi(value, &pos);
+            ok = pos == value.size() && opts.runs > 0;
+        } else if (opt == "--min-time") {
+            opts.min_time_ms = std::stod(value, &pos);
+            ok = pos == value.size() && opts.min_time_ms >= 0.0;
+        } else {
+            opts.report = value;
+            ok = value == "csv" || value == "json";
+        }
+    } catch (const std::exception&) {
+        ok = false;
+    }
+    if (!ok) {
+        if (opt == "--report") {
+            std::cerr << "Error: invalid --report. Use: csv, json\n";
+        } else if (opt == "--seed") {
+            std::cerr << "Error: --seed must be an unsigned 32-bit integer.\n";
+        } else if (opt == "--verify-tol") {
+            std::cerr << "Error: --verify-tol must be a positive number.\n";
+        } else {
+            std::cerr << "Error: " << opt << " must be a "
+                      << (opt == "--runs" ? "positive" : "non-negative") << " number.\n";
+        }
+    }
+    return true;
+}
+
+// Run f() opts.warmup times, then time it; returns ms per timed call.
+// start() / stop() are called right before the first and after the last
+// timed call (e.g. to enable hardware counters for the timed calls only).
+// reduce(ms) turns the time of one call into the value recorded, e.g. the
+// maximum over MPI ranks, so that every process stops after the same call.
+template <typename F, typename Start, typename Stop, typename Reduce>
+std::vector<double> bench_measure(const BenchOptions& opts, F f, Start start_timing,
+                                  Stop stop_timing, Reduce reduce) {
+    for (int k = 0; k < opts.warmup; ++k) f();
+
+    std::vector<double> times_ms;
+    times_ms.reserve(opts.runs);
+    double total_ms = 0.0;
+    start_timing();
+    while ((int)times_ms.size() < opts.runs || total_ms < opts.min_time_ms) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        const double ms = reduce(std::chrono::duration<double, std::milli>(end - start).count());
+        times_ms.push_back(ms);
+        total_ms += ms;
+    }
+    stop_timing();
+    return times_ms;
+}
+
+template <typename F, typename Start, typename Stop>
+std::vector<double> bench_measure(const BenchOptions& opts, F f, Start start_timing,
+                                  Stop stop_timing) {
+    return bench_measure(opts, f, start_timing, stop_timing, [](double ms) { return ms; });
+}
+
+template <typename F>
+std::vector<double> bench_measure(const BenchOptions& opts, F f) {
+    return bench_measure(opts, f, []() {}, []() {});
+}
+
+struct BenchStats {
+    double min_ms    = 0.0;
+    double median_ms = 0.0;
+    double mean_ms   = 0.0;
+    double p90_ms    = 0.0;    // nearest-rank 90th percentile
+    double stddev_ms = 0.0;    // sample standard deviation
+};
+
+inline BenchStats bench_stats(const std::vector<double>& times_ms) {
+    BenchStats s;
+    const size_t n = times_ms.size();
+    if (n == 0) return s;
+
+    std::vector<double> sorted(times_ms);
+    std::sort(sorted.begin(), sorted.end());
+    s.min_ms    = sorted.front();
+    s.median_ms = (n % 2) ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+    s.p90_ms    = sorted[std::max<size_t>(1, (size_t)std::ceil(0.9 * n)) - 1];
+
+    double sum = 0.0;
+    for (size_t k = 0; k < n; ++k) sum += sorted[k];
+    s.mean_ms = sum / n;
+
+    double sq = 0.0;
+    for (size_t k = 0; k < n; ++k) sq += (sorted[k] - s.mean_ms) * (sorted[k] - s.mean_ms);
+    s.stddev_ms = n > 1 ? std::sqrt(sq / (n - 1)) : 0.0;
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// Report
+// ---------------------------------------------------------------------------
+//
+// flops and bytes are per call: 2 * nnz (of the full matrix, times the
+// number of vectors) and the bytes the kernel streams (matrix arrays once,
+// input and output vectors once each). GFLOP/s and GB/s use the median time.
+
+struct BenchReport {
+    std::string matrix;
+    std::string kernel;          // CSV `schedule` column of the legacy line
+    int chunk   = 0;
+    int threads = 1;
+    std::string bind = "none";
+    long long rows = 0;
+    long long cols = 0;
+    long long nnz  = 0;
+    double flops   = 0.0;
+    double bytes   = 0.0;
+    int warmup     = 0;
+    std::vector<double> times_ms;
+    // Extra numeric columns appended after the metadata (e.g. counters)
+    std::vector<std::pair<std::string, double> > extra;
+};
+
+inline std::string bench_host_name() {
+#ifdef __linux__
+    char name[256] = {0};
+    if (gethostname(name, sizeof(name) - 1) == 0) return name;
+#endif
+    return "unknown";
+}
+
+inline std::string bench_compiler() {
+#if defined(__clang__)
+    return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    return std::string("gcc ") + __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+// Build flags: SPMV_BUILD_FLAGS when given on the command line
+// (-DSPMV_BUILD_FLAGS='"-O3 -fopenmp"'), otherwise what the predefined
+// macros reveal.
+inline std::string bench_build_flags() {
+#ifdef SPMV_BUILD_FLAGS
+    return SPMV_BUILD_FLAGS;
+#else
+    std::string flags;
+#ifdef __OPTIMIZE__
+    flags += "optimize ";
+#endif
+#ifdef _OPENMP
+    std::ostringstream omp;
+    omp << "openmp-" << _OPENMP << " ";
+    flags += omp.str();
+#endif
+#ifdef __AVX512F__
+    flags += "avx512f ";
+#elif defined(__AVX2__)
+    flags += "avx2 ";
+#endif
+#ifdef __FMA__
+    flags += "fma ";
+#endif
+    if (!flags.empty()) flags.erase(flags.size() - 1);
+    return flags;
+#endif
+}
+
+// Quote a string for CSV / JSON (both use "..." with the quote escaped).
+inline std::string bench_quote(const std::string& s, bool json) {
+    std::string out = "\"";
+    for (size_t k = 0; k < s.size(); ++k) {
+        if (s[k] == '"') out += json ? "\\\"" : "\"\"";
+        else if (s[k] == '\\' && json) out += "\\\\";
+        else out += s[k];
+    }
+    return out + "\"";
+}
+
+// csv: header line (unless header is false, e.g. for later rows of a
+// sweep) and one data line; json: one object per line.
+inline void bench_print_report(std::ostream& out, const std::string& format,
+                               const BenchReport& r, bool header = true) {
+    const BenchStats s = bench_stats(r.times_ms);
+    const double gflops = s.median_ms > 0.0 ? r.flops / (s.median_ms * 1.0e6) : 0.0;
+    const double gbs    = s.median_ms > 0.0 ? r.bytes / (s.median_ms * 1.0e6) : 0.0;
+    const bool json = (format == "json");
+
+    // name / value pairs in output order; strings are quoted
+    std::vector<std::pair<std::string, std::string> > fields;
+    auto num = [](double x) {
+        std::ostringstream os;
+        os.precision(10);
+        os << x;
+        return os.str();
+    };
+    fields.push_back(std::make_pair("matrix", bench_quote(r.matrix, json)));
+    fields.push_back(std::make_pair("kernel", bench_quote(r.kernel, json)));
+    fields.push_back(std::make_pair("chunk", num(r.chunk)));
+    fields.push_back(std::make_pair("threads", num(r.threads)));
+    fields.push_back(std::make_pair("bind", bench_quote(r.bind, json)));
+    fields.push_back(std::make_pair("rows", num((double)r.rows)));
+    fields.push_back(std::make_pair("cols", num((double)r.cols)));
+    fields.push_back(std::make_pair("nnz", num((double)r.nnz)));
+    fields.push_back(std::make_pair("warmup", num(r.warmup)));
+    fields.push_back(std::make_pair("runs", num((double)r.times_ms.size())));
+    fields.push_back(std::make_pair("min_ms", num(s.min_ms)));
+    fields.push_back(std::make_pair("median_ms", num(s.median_ms)));
+    fields.push_back(std::make_pair("mean_ms", num(s.mean_ms)));
+    fields.push_back(std::make_pair("p90_ms", num(s.p90_ms)));
+    fields.push_back(std::make_pair("stddev_ms", num(s.stddev_ms)));
+    fields.push_back(std::make_pair("gflops", num(gflops)));
+    fields.push_back(std::make_pair("bytes_per_call", num(r.bytes)));
+    fields.push_back(std::make_pair("gbs", num(gbs)));
+    fields.push_back(std::make_pair("host", bench_quote(bench_host_name(), json)));
+    fields.push_back(std::make_pair("compiler", bench_quote(bench_compiler(), json)));
+    fields.push_back(std::make_pair("flags", bench_quote(bench_build_flags(), json)));
+    for (size_t k = 0; k < r.extra.size(); ++k) {
+        fields.push_back(std::make_pair(r.extra[k].first, num(r.extra[k].second)));
+    }
+
+    if (json) {
+        out << "{";
+        for (size_t k = 0; k < fields.size(); ++k) {
+            out << (k ? ", " : "") << bench_quote(fields[k].first, true) << ": "
+                << fields[k].second;
+        }
+        out << ", \"times_ms\": [";
+        for (size_t k = 0; k < r.times_ms.size(); ++k) {
+            out << (k ? ", " : "") << num(r.times_ms[k]);
+        }
+        out << "]}\n";
+    } else {
+        if (header) {
+            for (size_t k = 0; k < fields.size(); ++k) out << (k ? "," : "") << fields[k].first;
+            out << "\n";
+        }
+        for (size_t k = 0; k < fields.size(); ++k) out << (k ? "," : "") << fields[k].second;
+        out << "\n";
+    }
+}
+
+// One result line: with opts.report the report of r, completed with the
+// kernel label, the flops and bytes per call, the timed calls and the extra
+// columns (a csv header only before the first line, tracked in
+// header_printed); otherwise the legacy line
+// matrix,kernel,chunk,threads,bind,run1,... followed by legacy_extra.
+// r carries the columns a run shares (matrix, chunk, threads, bind, rows,
+// cols, nnz).
+inline void bench_print_result(std::ostream& out, const BenchOptions& opts, BenchReport r,
+                               const std::string& label, double flops, double bytes,
+                               const std::vector<double>& times_ms,
+                               const std::vector<std::pair<std::string, double> >& extra,
+                               bool& header_printed,
+                               const std::vector<double>& legacy_extra = std::vector<double>()) {
+    r.kernel   = label;
+    r.flops    = flops;
+    r.bytes    = bytes;
+    r.warmup   = opts.warmup;
+    r.times_ms = times_ms;
+    r.extra    = extra;
+    if (!opts.report.empty()) {
+        bench_print_report(out, opts.report, r, !header_printed);
+        header_printed = true;
+        return;
+    }
+
+    out << r.matrix << "," << r.kernel << "," << r.chunk << "," << r.threads << "," << r.bind;
+    for (size_t run = 0; run < times_ms.size(); ++run) out << "," << times_ms[run];
+    for (size_t k = 0; k < legacy_extra.size(); ++k) out << "," << legacy_extra[k];
+    out << "\n";
+}
+
+#endif // BENCH_H
@@ -0,0 +1,529 @@
+#ifndef CSR_KERNELS_H
+#define CSR_KERNELS_H
+
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+#include "csr_matrix.h"
+#include "thread_team.h"
+#include "work_steal.h"
+#include "thread_stats.h"
+
+// ---------------------------------------------------------------------------
+// CSR SpMV kernels and their work splits
+// ---------------------------------------------------------------------------
+//
+// Shared by the drivers (spmv, spmv_seq, spmv_mpi) and by the kernel
+// registry (kernel_registry.h). Every kernel computes c = A v and
+// overwrites c; the work splits (RowPartition, MergePathPlan,
+// SymmetricSpmvPlan, WorkStealRows, or a CsrSplitPlan for a schedule) are
+// built once per matrix and reused by every call.
+
+// Thread number inside the parallel regions of the kernels below. Without
+// OpenMP a region runs once, so the plans must then be built for one thread.
+inline int csr_kernel_thread() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+// Threads the region actually got. num_threads(n) is only a request: the
+// runtime may give fewer (OMP_THREAD_LIMIT, OMP_DYNAMIC), so the kernels
+// over per-thread blocks deal the blocks out to the threads they have.
+inline int csr_kernel_team_size() {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+// The CSR kernels are templated on the matrix value type V and on the vector
+// type X, which is also the accumulator type: <double, double> is the fp64
+// default, <float, double> streams fp32 values but accumulates in fp64 and
+// <float, float> is fp32 throughout. The sequential and runtime-schedule
+// kernels are also templated on the offset / index types P / I of the matrix
+// (see csr_index_width), so they run on matrices beyond 2^31 nonzeros.
+
+// Sequential SpMV in CSR format (used for warm-up or debugging)
+template <typename V, typename X, typename P, typename I>
+void spmv_csr_sequential(const BasicCsrMatrix<V, P, I>& A,
+                         const std::vector<X>& v,
+                         std::vector<X>& c) {
+    const P* row_ptr = A.row_ptr.data();
+    const I* col_ind = A.col_ind.data();
+    const V* values  = A.values.data();
+    const X* v_in    = v.data();
+    X* c_out         = c.data();
+
+    const I rows = A.rows;
+
+    for (I i = 0; i < rows; ++i) {
+        X sum = 0;
+        const P row_start = row_ptr[i];
+        const P row_end   = row_ptr[i + 1];
+        for (P j = row_start; j < row_end; ++j) {
+            sum += values[j] * v_in[col_ind[j]];
+        }
+        c_out[i] = sum;
+    }
+}
+
+// Parallel SpMV (CSR format) using schedule(runtime)
+// The actual OpenMP schedule and chunk size are configured by the caller via
+// omp_set_schedule() and omp_set_num_threads().
+template <typename V, typename X, typename P, typename I>
+void spmv_csr_parallel(const BasicCsrMatrix<V, P, I>& A,
+                       const std::vector<X>& v,
+                       std::vector<X>& c) {
+    const P* row_ptr = A.row_ptr.data();
+    const I* col_ind = A.col_ind.data();
+    const V* values  = A.values.data();
+    const X* v_in    = v.data();
+    X* c_out         = c.data();
+
+    const I rows = A.rows;
+
+    // Outer loop over rows is parallelized.
+    // Each thread processes a subset of rows independently.
+    #pragma omp parallel for schedule(runtime)
+    for (I i = 0; i < rows; ++i) {
+        X sum = 0;
+        const P row_start = row_ptr[i];
+        const P row_end   = row_ptr[i + 1];
+
+        for (P j = row_start; j < row_end; ++j) {
+            sum += values[j] * v_in[col_ind[j]];
+        }
+
+        // No race condition: each thread writes to a distinct c_out[i]
+        c_out[i] = sum;
+    }
+}
+
+// spmv_csr_parallel with per-thread rows, nonzeros, busy and barrier wait
+// time recorded in stats (thread_stats.h); the team must not be larger than
+// stats.nthreads()
+template <typename V, typename X, typename P, typename I>
+void spmv_csr_parallel_timed(const BasicCsrMatrix<V, P, I>& A,
+                             const std::vector<X>& v,
+                             std::vector<X>& c,
+                             ThreadStats& stats) {
+    const P* row_ptr = A.row_ptr.data();
+    const I* col_ind = A.col_ind.data();
+    const V* values  = A.values.data();
+    const X* v_in    = v.data();
+    X* c_out         = c.data();
+
+    const I rows = A.rows;
+
+    stats.begin_call();
+    #pragma omp parallel
+    {
+        const unsigned long long start = thread_stats_ticks();
+        long long my_rows = 0, my_nnz = 0;
+
+        #pragma omp for schedule(runtime) nowait
+        for (I i = 0; i < rows; ++i) {
+            X sum = 0;
+            const P row_start = row_ptr[i];
+            const P row_end   = row_ptr[i + 1];
+
+            for (P j = row_start; j < row_end; ++j) {
+                sum += values[j] * v_in[col_ind[j]];
+            }
+            c_out[i] = sum;
+            ++my_rows;
+            my_nnz += row_end - row_start;
+        }
+        const unsigned long long done = thread_stats_ticks();
+
+        #pragma omp barrier
+        ThreadStatsSlot& slot = stats.slot(csr_kernel_thread());
+        slot.rows = my_rows;
+        slot.nnz  = my_nnz;
+        slot.busy = done - start;
+        slot.wait = thread_stats_ticks() - done;
+    }
+    stats.end_call();
+}
+
+// Parallel SpMV (CSR format) over a precomputed nnz-balanced partition:
+// thread t processes the contiguous rows of block t, so every thread gets
+// about the same number of nonzeros without any per-chunk scheduling cost
+// (a smaller team takes the blocks of the missing threads in turn).
+template <typename V, typename X>
+void spmv_csr_balanced(const BasicCsrMatrix<V>& A, const RowPartition& part,
+                       const std::vector<X>& v,
+                       std::vector<X>& c) {
+    const int* row_ptr = A.row_ptr.data();
+    const int* col_ind = A.col_ind.data();
+    const V* values    = A.values.data();
+    const X* v_in      = v.data();
+    X* c_out           = c.data();
+
+    #pragma omp parallel num_threads(part.nparts)
+    {
+        const int nth = csr_kernel_team_size();
+        for (int t = csr_kernel_thread(); t < part.nparts; t += nth) {
+            const int row_begin = part.row_begin[t];
+            const int row_end   = part.row_begin[t + 1];
+
+            for (int i = row_begin; i < row_end; ++i) {
+                X sum = 0;
+                for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                    sum += values[j] * v_in[col_ind[j]];
+                }
+                c_out[i] = sum;
+            }
+        }
+    }
+}
+
+// Same row blocks as spmv_csr_balanced, but run on a persistent thread team
+// (part.nparts == team.size()): a call costs one generation bump and one
+// spin barrier instead of an OpenMP fork/join.
+template <typename V, typename X>
+void spmv_csr_persistent(const BasicCsrMatrix<V>& A, const RowPartition& part,
+                         ThreadTeam& team,
+                         const std::vector<X>& v,
+                         std::vector<X>& c) {
+    const int* row_ptr = A.row_ptr.data();
+    const int* col_ind = A.col_ind.data();
+    const V* values    = A.values.data();
+    const X* v_in      = v.data();
+    X* c_out           = c.data();
+
+    team.run([&](int tid) {
+        const int row_begin = part.row_begin[tid];
+        const int row_end   = part.row_begin[tid + 1];
+
+        for (int i = row_begin; i < row_end; ++i) {
+            X sum = 0;
+            for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                sum += values[j] * v_in[col_ind[j]];
+            }
+            c_out[i] = sum;
+        }
+    });
+}
+
+// Work-stealing SpMV: every thread starts on its nnz-balanced slice and
+// idle threads steal half of the remaining rows of another thread, so
+// irregular matrices get dynamic-like balance without a shared counter.
+template <typename V, typename X>
+void spmv_csr_steal(const BasicCsrMatrix<V>& A, WorkStealRows& ws,
+                    const std::vector<X>& v,
+                    std::vector<X>& c) {
+    const int* row_ptr = A.row_ptr.data();
+    const int* col_ind = A.col_ind.data();
+    const V* values    = A.values.data();
+    const X* v_in      = v.data();
+    X* c_out           = c.data();
+
+    ws.reset();
+    #pragma omp parallel num_threads(ws.nthreads())
+    {
+        const int tid = csr_kernel_thread();
+        const int nth = csr_kernel_team_size();
+        int row_begin = 0, row_end = 0;
+        while (ws.next(tid, nth, row_begin, row_end)) {
+            for (int i = row_begin; i < row_end; ++i) {
+                X sum = 0;
+                for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                    sum += values[j] * v_in[col_ind[j]];
+                }
+                c_out[i] = sum;
+            }
+        }
+    }
+}
+
+// Merge-path SpMV (Merrill & Garland, as used by CSR5-style engines).
+// The kernel is viewed as a merge of the row end offsets (row_ptr[1..rows])
+// with the nonzero indices 0..nnz-1. Every thread gets an equal share of
+// the combined rows + nnz items, found by a binary search along its
+// starting diagonal, so the work per thread is balanced no matter how the
+// nonzeros are distributed over the rows. A row split between threads is
+// finished by a serial carry-out fix-up (at most one per thread).
+struct MergePathPlan {
+    int nthreads = 0;
+    std::vector<int> start_row;       // nthreads + 1 merge coordinates
+    std::vector<int> start_nz;
+    std::vector<int> carry_row;       // row left unfinished by each thread
+    std::vector<double> carry_value;  // its partial sum
+};
+
+// Find the merge coordinate (row, nz) on the given diagonal (row + nz).
+// The diagonal runs up to rows + nnz, which can exceed INT_MAX even when
+// both fit in an int, so the search is done in long long.
+inline void merge_path_search(long long diagonal, const int* row_end, int rows, int nnz,
+                              int& row, int& nz) {
+    long long lo = std::max(diagonal - nnz, 0LL);
+    long long hi = std::min(diagonal, (long long)rows);
+    while (lo < hi) {
+        const long long pivot = lo + (hi - lo) / 2;
+        if (row_end[pivot] <= diagonal - pivot - 1) {
+            lo = pivot + 1;
+        } else {
+            hi = pivot;
+        }
+    }
+    row = static_cast<int>(std::min(lo, (long long)rows));
+    nz  = static_cast<int>(diagonal - lo);
+}
+
+inline void build_merge_path_plan(const CsrMatrix& A, int nthreads, MergePathPlan& plan) {
+    plan.nthreads = nthreads;
+    plan.start_row.resize(nthreads + 1);
+    plan.start_nz.resize(nthreads + 1);
+    plan.carry_row.assign(nthreads, 0);
+    plan.carry_value.assign(nthreads, 0.0);
+
+    const long long total = (long long)A.rows + A.nnz;
+    for (int t = 0; t <= nthreads; ++t) {
+        const long long diagonal = std::min(total, total * t / nthreads);
+        merge_path_search(diagonal, A.row_ptr.data() + 1, A.rows, A.nnz,
+                          plan.start_row[t], plan.start_nz[t]);
+    }
+}
+
+template <typename V, typename X>
+void spmv_csr_merge(const BasicCsrMatrix<V>& A, MergePathPlan& plan,
+                    const std::vector<X>& v,
+                    std::vector<X>& c) {
+    const int* row_end = A.row_ptr.data() + 1;
+    const int* col_ind = A.col_ind.data();
+    const V* values    = A.values.data();
+    const X* v_in      = v.data();
+    X* c_out           = c.data();
+
+    // A smaller team than plan.nthreads takes the missing shares in turn
+    #pragma omp parallel num_threads(plan.nthreads)
+    {
+        const int nth = csr_kernel_team_size();
+        for (int t = csr_kernel_thread(); t < plan.nthreads; t += nth) {
+            int row          = plan.start_row[t];
+            int nz           = plan.start_nz[t];
+            const int row_to = plan.start_row[t + 1];
+            const int nz_to  = plan.start_nz[t + 1];
+
+            // Rows that end inside this share
+            X sum = 0;
+            for (; row < row_to; ++row) {
+                for (; nz < row_end[row]; ++nz) {
+                    sum += values[nz] * v_in[col_ind[nz]];
+                }
+                c_out[row] = sum;
+                sum = 0;
+            }
+
+            // Leading part of a row that continues in the next share
+            for (; nz < nz_to; ++nz) {
+                sum += values[nz] * v_in[col_ind[nz]];
+            }
+            plan.carry_row[t]   = row_to;
+            plan.carry_value[t] = sum;
+        }
+    }
+
+    // Carry-out fix-up: the thread that finished a row wrote it with "=",
+    // so the partial sums of the threads before it are added afterwards.
+    for (int t = 0; t < plan.nthreads; ++t) {
+        if (plan.carry_row[t] < A.rows) {
+            c_out[plan.carry_row[t]] += static_cast<X>(plan.carry_value[t]);
+        }
+    }
+}
+
+// Work split for the half-storage symmetric kernel (A.symmetric == true).
+// Each thread owns a contiguous block of rows of the nnz-balanced
+// RowPartition. Because only the lower
+// triangle is stored, the transposed update c[j] += a_ij * v[i] always goes
+// to a row j <= i: if j is inside the own block it is applied directly,
+// otherwise it goes to a private buffer covering [buf_lo[t], row_begin[t]).
+// After a barrier every thread adds the buffer slices that overlap its own
+// block, so the kernel needs no atomics and is deterministic.
+struct SymReduceSegment {
+    int source;   // thread whose buffer holds the contributions
+    int begin;    // row range [begin, end) inside the owner's block
+    int end;
+};
+
+struct SymmetricSpmvPlan {
+    int nthreads = 0;
+    RowPartition part;               // one row block per thread
+    std::vector<int> buf_lo;              // first row covered by each buffer
+    std::vector<size_t> buf_offset;       // nthreads + 1 offsets into buffer
+    std::vector<double> buffer;           // all per-thread buffers, back to back
+    std::vector<std::vector<SymReduceSegment> > reduce;   // per owner thread
+};
+
+inline void build_symmetric_plan(const CsrMatrix& A, int nthreads,
+                                 SymmetricSpmvPlan& plan) {
+    const int* row_ptr = A.row_ptr.data();
+    const int* col_ind = A.col_ind.data();
+
+    plan.nthreads = nthreads;
+    partition_rows_by_nnz(A, nthreads, plan.part);
+    plan.buf_lo.resize(nthreads);
+    plan.buf_offset.assign(nthreads + 1, 0);
+    plan.reduce.assign(nthreads, std::vector<SymReduceSegment>());
+
+    const std::vector<int>& row_begin = plan.part.row_begin;
+    for (int t = 0; t < nthreads; ++t) {
+        const int r0 = row_begin[t];
+        const int r1 = row_begin[t + 1];
+        int lo = r0;
+        for (int i = r0; i < r1; ++i) {
+            // Columns are sorted, so the first entry is the smallest
+            if (row_ptr[i] < row_ptr[i + 1]) lo = std::min(lo, col_ind[row_ptr[i]]);
+        }
+        plan.buf_lo[t] = lo;
+        plan.buf_offset[t + 1] = plan.buf_offset[t] + (r0 - lo);
+    }
+    plan.buffer.assign(plan.buf_offset[nthreads], 0.0);
+
+    for (int t = 0; t < nthreads; ++t) {
+        for (int s = t + 1; s < nthreads; ++s) {
+            const int begin = std::max(plan.buf_lo[s], row_begin[t]);
+            const int end   = std::min(row_begin[s], row_begin[t + 1]);
+            if (begin < end) {
+                SymReduceSegment seg = {s, begin, end};
+                plan.reduce[t].push_back(seg);
+            }
+        }
+    }
+}
+
+// Parallel SpMV for a symmetric matrix stored as its lower triangle: every
+// stored entry is read once and applied twice, to c[i] and to c[j].
+inline void spmv_csr_symmetric(const CsrMatrix& A, SymmetricSpmvPlan& plan,
+                               const std::vector<double>& v,
+                               std::vector<double>& c) {
+    const int* row_ptr   = A.row_ptr.data();
+    const int* col_ind   = A.col_ind.data();
+    const double* values = A.values.data();
+    const double* v_in   = v.data();
+    double* c_out        = c.data();
+
+    // A smaller team than plan.nthreads takes the blocks (and buffers) of
+    // the missing threads in turn; a block only writes its own rows and its
+    // own buffer, so the blocks of one thread need no ordering
+    #pragma omp parallel num_threads(plan.nthreads)
+    {
+        const int nth = csr_kernel_team_size();
+        for (int t = csr_kernel_thread(); t < plan.nthreads; t += nth) {
+            const int r0  = plan.part.row_begin[t];
+            const int r1  = plan.part.row_begin[t + 1];
+            const int lo  = plan.buf_lo[t];
+            double* buf   = plan.buffer.data() + plan.buf_offset[t];
+
+            std::fill(buf, buf + (r0 - lo), 0.0);
+            std::fill(c_out + r0, c_out + r1, 0.0);
+
+            for (int i = r0; i < r1; ++i) {
+                const double v_i = v_in[i];
+                double sum = 0.0;
+                for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                    const int col  = col_ind[j];
+                    const double a = values[j];
+                    sum += a * v_in[col];
+                    if (col == i) continue;
+
+                    // Transposed contribution a_ij * v_i to row col < i
+                    if (col >= r0) {
+                        c_out[col] += a * v_i;
+                    } else {
+                        buf[col - lo] += a * v_i;
+                    }
+                }
+                c_out[i] += sum;
+            }
+        }
+
+        #pragma omp barrier
+
+        // Collect the contributions other blocks buffered for our rows
+        for (int t = csr_kernel_thread(); t < plan.nthreads; t += nth) {
+            const std::vector<SymReduceSegment>& segments = plan.reduce[t];
+            for (size_t k = 0; k < segments.size(); ++k) {
+                const SymReduceSegment& seg = segments[k];
+                const double* src = plan.buffer.data() + plan.buf_offset[seg.source]
+                                    - plan.buf_lo[seg.source];
+                for (int i = seg.begin; i < seg.end; ++i) {
+                    c_out[i] += src[i];
+                }
+            }
+        }
+    }
+}
+
+// How the rows of the CSR kernel are shared out among the threads
+enum CsrSchedule {
+    CSR_SCHEDULE_RUNTIME,      // OpenMP schedule(runtime)
+    CSR_SCHEDULE_BALANCED,     // contiguous nnz-balanced row blocks
+    CSR_SCHEDULE_MERGE,        // merge-path split of rows + nnz
+    CSR_SCHEDULE_PERSISTENT,   // balanced blocks on a persistent thread team
+    CSR_SCHEDULE_STEAL         // balanced blocks with work stealing
+};
+
+// Work split of a schedule. It depends on row_ptr only, so matrices with
+// the same structure (e.g. an fp32 copy of the values) share one plan.
+struct CsrSplitPlan {
+    CsrSchedule schedule = CSR_SCHEDULE_RUNTIME;
+    RowPartition partition;             // balanced, persistent, steal
+    MergePathPlan merge_plan;           // merge
+    RowPartition merge_rows;            // start rows of the merge shares
+    WorkStealRows steal;                // steal
+    std::unique_ptr<ThreadTeam> team;   // persistent
+
+    // Rows of every thread, as the kernel splits them (for first-touch
+    // placement); nullptr for the runtime schedule
+    const RowPartition* row_owners() const {
+        switch (schedule) {
+            case CSR_SCHEDULE_RUNTIME: return nullptr;
+            case CSR_SCHEDULE_MERGE:   return &merge_rows;
+            default:                   return &partition;
+        }
+    }
+};
+
+// chunk: rows the owner takes at a time (steal). A team already in plan
+// is kept, e.g. one moved over from the plan of another matrix with its
+// threads still bound.
+inline void build_csr_split(const CsrMatrix& A, CsrSchedule schedule, int nthreads, int chunk,
+                            CsrSplitPlan& plan) {
+    plan.schedule = schedule;
+    if (schedule == CSR_SCHEDULE_MERGE) {
+        build_merge_path_plan(A, nthreads, plan.merge_plan);
+        plan.merge_rows.nparts    = nthreads;
+        plan.merge_rows.row_begin = plan.merge_plan.start_row;
+    } else if (schedule != CSR_SCHEDULE_RUNTIME) {
+        partition_rows_by_nnz(A, nthreads, plan.partition);
+    }
+    if (schedule == CSR_SCHEDULE_STEAL) plan.steal.init(plan.partition, chunk);
+    if (schedule == CSR_SCHEDULE_PERSISTENT && !plan.team) {
+        plan.team.reset(new ThreadTeam(nthreads));
+    }
+}
+
+// CSR kernel of the plan's schedule
+template <typename V, typename X>
+void spmv_csr_split(const BasicCsrMatrix<V>& A, CsrSplitPlan& plan,
+                    const std::vector<X>& v,
+                    std::vector<X>& c) {
+    switch (plan.schedule) {
+        case CSR_SCHEDULE_BALANCED:   spmv_csr_balanced(A, plan.partition, v, c); break;
+        case CSR_SCHEDULE_MERGE:      spmv_csr_merge(A, plan.merge_plan, v, c); break;
+        case CSR_SCHEDULE_PERSISTENT: spmv_csr_persistent(A, plan.partition, *plan.team, v, c);
+                                      break;
+        case CSR_SCHEDULE_STEAL:      spmv_csr_steal(A, plan.steal, v, c); break;
+        default:                      spmv_csr_parallel(A, v, c); break;
+    }
+}
+
+#endif // CSR_KERNELS_H
@@ -0,0 +1,312 @@
+#ifndef CSR_MATRIX_H
+#define CSR_MATRIX_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Number of threads used to ingest and convert matrices. Loading is
+// independent of the thread count of the benchmark, so it uses every core
+// available to the process.
+inline int io_num_threads() {
+#ifdef _OPENMP
+    return omp_get_num_procs();
+#else
+    return 1;
+#endif
+}
+
+struct Triplet {
+    int row;
+    int col;
+    double val;
+};
+
+inline bool compareTriplets(const Triplet& a, const Triplet& b) {
+    if (a.row < b.row) return true;
+    if (a.row == b.row) return a.col < b.col;
+    return false;
+}
+
+// CSR matrix with value type V, offset type P (row_ptr, nnz) and index type
+// I (rows, cols, col_ind). Loading, caching and every derived format work on
+// CsrMatrix (double, 32-bit); float copies for mixed-precision runs are made
+// with csr_convert_values.
+//
+// Matrices with 2^31 or more stored entries need 64-bit offsets
+// (CsrMatrix64, col_ind stays 32-bit); only more than 2^31 rows or columns
+// need 64-bit column indices as well (CsrMatrix64x64). csr_index_width()
+// picks the narrowest choice from the file header, so small matrices keep
+// the 4-byte indices and their bandwidth.
+template <typename V, typename P = int, typename I = int>
+struct BasicCsrMatrix {
+    typedef V value_type;
+    typedef P offset_type;
+    typedef I index_type;
+
+    I rows = 0;
+    I cols = 0;
+    P nnz  = 0;
+    // true: only the lower triangle (incl. diagonal) of a symmetric matrix is
+    // stored; use the symmetric SpMV kernel, which applies every
+    // off-diagonal entry to both (i, j) and (j, i).
+    bool symmetric = false;
+    std::vector<P> row_ptr;
+    std::vector<I> col_ind;
+    std::vector<V> values;
+};
+
+typedef BasicCsrMatrix<double> CsrMatrix;
+typedef BasicCsrMatrix<double, long long> CsrMatrix64;
+typedef BasicCsrMatrix<double, long long, long long> CsrMatrix64x64;
+
+enum CsrIndexWidth {
+    CSR_INDEX_32,      // int row_ptr, int col_ind
+    CSR_OFFSET_64,     // 64-bit row_ptr, int col_ind
+    CSR_INDEX_64       // 64-bit row_ptr and col_ind
+};
+
+inline const char* csr_index_width_name(CsrIndexWidth w) {
+    return w == CSR_INDEX_32 ? "32" : (w == CSR_OFFSET_64 ? "64" : "64x64");
+}
+
+// Narrowest index width for a matrix with the given size and number of
+// stored entries (after any symmetric expansion).
+inline CsrIndexWidth csr_index_width(long long rows, long long cols, long long entries) {
+    const long long int_max = 2147483647LL;
+    if (rows >= int_max || cols >= int_max) return CSR_INDEX_64;
+    if (entries > int_max) return CSR_OFFSET_64;
+    return CSR_INDEX_32;
+}
+
+// Copy the structure of src and convert its values to the value type of dst.
+template <typename V, typename W>
+inline void csr_convert_values(const BasicCsrMatrix<W>& src, BasicCsrMatrix<V>& dst) {
+    dst.rows      = src.rows;
+    dst.cols      = src.cols;
+    dst.nnz       = src.nnz;
+    dst.symmetric = src.symmetric;
+    dst.row_ptr   = src.row_ptr;
+    dst.col_ind   = src.col_ind;
+    dst.values.resize(src.values.size());
+
+    const long long n = static_cast<long long>(src.values.size());
+    #pragma omp parallel for schedule(static) num_threads(io_num_threads())
+    for (long long k = 0; k < n; ++k) {
+        dst.values[k] = static_cast<V>(src.values[k]);
+    }
+}
+
+// Static split of the rows into contiguous blocks with roughly equal nnz,
+// one block per thread: block t is [row_begin[t], row_begin[t + 1]).
+// Computed once per matrix and reused by every SpMV call.
+struct RowPartition {
+    int nparts = 0;
+    std::vector<int> row_begin;   // nparts + 1 boundaries
+};
+
+// Block t starts at the first row whose row_ptr reaches t * nnz / nparts,
+// found by binary search over row_ptr (O(nparts log rows)).
+inline void partition_rows_by_nnz(const CsrMatrix& A, int nparts, RowPartition& part) {
+    const int* row_ptr = A.row_ptr.data();
+
+    part.nparts = nparts;
+    part.row_begin.resize(nparts + 1);
+    part.row_begin[0]      = 0;
+    part.row_begin[nparts] = A.rows;
+    for (int t = 1; t < nparts; ++t) {
+        const int target = static_cast<int>((long long)A.nnz * t / nparts);
+        const int* it = std::lower_bound(row_ptr, row_ptr + A.rows + 1, target);
+        const int row = std::min(A.rows, static_cast<int>(it - row_ptr));
+        part.row_begin[t] = std::max(part.row_begin[t - 1], row);
+    }
+}
+
+// In-place parallel inclusive scan of row_ptr[1..rows]: turns per-row entry
+// counts stored at row_ptr[i + 1] into CSR row offsets. T is the offset
+// type (int for CSR, wider types for byte offsets of derived formats).
+template <typename T>
+inline void csr_prefix_sum(std::vector<T>& row_ptr) {
+    const long long n = static_cast<long long>(row_ptr.size()) - 1;
+    if (n <= 0) return;
+    T* a = row_ptr.data() + 1;
+
+    std::vector<T> block_sum;
+    #pragma omp parallel num_threads(io_num_threads())
+    {
+        int nthreads = 1, tid = 0;
+#ifdef _OPENMP
+        nthreads = omp_get_num_threads();
+        tid      = omp_get_thread_num();
+#endif
+        #pragma omp single
+        block_sum.assign(nthreads + 1, 0);
+
+        const long long begin = n * tid / nthreads;
+        const long long end   = n * (tid + 1) / nthreads;
+
+        // 1) local inclusive scan of each block
+        for (long long i = begin + 1; i < end; ++i) a[i] += a[i - 1];
+        block_sum[tid + 1] = (end > begin) ? a[end - 1] : 0;
+
+        #pragma omp barrier
+        #pragma omp single
+        for (int t = 0; t < nthreads; ++t) block_sum[t + 1] += block_sum[t];
+
+        // 2) shift every block by the total of the blocks before it
+        const T offset = block_sum[tid];
+        if (offset != 0) {
+            for (long long i = begin; i < end; ++i) a[i] += offset;
+        }
+    }
+}
+
+// Sort the entries of every row by column index. Rows that are already
+// ordered (the common case for files written row- or column-major) are only
+// scanned, so this is close to free on well-ordered input.
+template <typename P, typename I>
+inline void csr_sort_rows(BasicCsrMatrix<double, P, I>& csr) {
+    const P* row_ptr = csr.row_ptr.data();
+    I* col_ind       = csr.col_ind.data();
+    double* values   = csr.values.data();
+
+    #pragma omp parallel num_threads(io_num_threads())
+    {
+        std::vector<std::pair<I, double> > scratch;
+
+        #pragma omp for schedule(dynamic, 1024)
+        for (I i = 0; i < csr.rows; ++i) {
+            const P row_start = row_ptr[i];
+            const P row_end   = row_ptr[i + 1];
+
+            bool sorted = true;
+            for (P j = row_start + 1; j < row_end && sorted; ++j) {
+                sorted = col_ind[j - 1] <= col_ind[j];
+            }
+            if (sorted) continue;
+
+            scratch.clear();
+            for (P j = row_start; j < row_end; ++j) {
+                scratch.push_back(std::make_pair(col_ind[j], values[j]));
+            }
+            std::sort(scratch.begin(), scratch.end(),
+                      [](const std::pair<I, double>& a, const std::pair<I, double>& b) {
+                          return a.first < b.first;
+                      });
+            for (P j = row_start; j < row_end; ++j) {
+                col_ind[j] = scratch[j - row_start].first;
+                values[j]  = scratch[j - row_start].second;
+            }
+        }
+    }
+}
+
+// Convert COO -> CSR with a parallel counting sort instead of a full
+// comparison sort: histogram the rows, prefix-sum into row_ptr, scatter
+// every entry into its row and finally order the columns of unsorted rows.
+inline void coo_to_csr(const std::vector<Triplet>& triplets, int rows, int cols,
+                       CsrMatrix& csr) {
+    const int nnz = static_cast<int>(triplets.size());
+
+    csr.rows = rows;
+    csr.cols = cols;
+    csr.nnz  = nnz;
+    csr.row_ptr.assign(rows + 1, 0);
+    csr.col_ind.resize(nnz);
+    csr.values.resize(nnz);
+
+    int* row_ptr = csr.row_ptr.data();
+
+    #pragma omp parallel for schedule(static) num_threads(io_num_threads())
+    for (int k = 0; k < nnz; ++k) {
+        #pragma omp atomic
+        row_ptr[triplets[k].row + 1]++;
+    }
+
+    csr_prefix_sum(csr.row_ptr);
+
+    // Next free slot of every row
+    std::vector<int> cursor(csr.row_ptr.begin(), csr.row_ptr.end() - 1);
+    int* next = cursor.data();
+
+    #pragma omp parallel for schedule(static) num_threads(io_num_threads())
+    for (int k = 0; k < nnz; ++k) {
+        int slot;
+        #pragma omp atomic capture
+        slot = next[triplets[k].row]++;
+
+        csr.col_ind[slot] = triplets[k].col;
+        csr.values[slot]  = triplets[k].val;
+    }
+
+    csr_sort_rows(csr);
+}
+
+// Expand a matrix stored as its lower triangle to full CSR: every
+// off-diagonal entry (i, j, a) is mirrored to (j, i, sign * a), with
+// sign = 1 for symmetric and -1 for skew-symmetric matrices.
+template <typename P, typename I>
+inline void csr_expand_symmetric(const BasicCsrMatrix<double, P, I>& lower, double sign,
+                                 BasicCsrMatrix<double, P, I>& full) {
+    const I rows = lower.rows;
+    const P* l_row_ptr     = lower.row_ptr.data();
+    const I* l_col_ind     = lower.col_ind.data();
+    const double* l_values = lower.values.data();
+
+    full.rows      = rows;
+    full.cols      = lower.cols;
+    full.symmetric = false;
+    full.row_ptr.assign(rows + 1, 0);
+    P* row_ptr = full.row_ptr.data();
+
+    // Row i keeps its own entries and receives one mirrored entry per
+    // off-diagonal entry in column i.
+    #pragma omp parallel for schedule(static) num_threads(io_num_threads())
+    for (I i = 0; i < rows; ++i) {
+        P own = 0;
+        for (P j = l_row_ptr[i]; j < l_row_ptr[i + 1]; ++j) {
+            ++own;
+            if (l_col_ind[j] != i) {
+                #pragma omp atomic
+                row_ptr[l_col_ind[j] + 1]++;
+            }
+        }
+        #pragma omp atomic
+        row_ptr[i + 1] += own;
+    }
+
+    csr_prefix_sum(full.row_ptr);
+    full.nnz = row_ptr[rows];
+    full.col_ind.resize(full.nnz);
+    full.values.resize(full.nnz);
+
+    std::vector<P> cursor(full.row_ptr.begin(), full.row_ptr.end() - 1);
+    P* next = cursor.data();
+
+    #pragma omp parallel for schedule(static) num_threads(io_num_threads())
+    for (I i = 0; i < rows; ++i) {
+        for (P j = l_row_ptr[i]; j < l_row_ptr[i + 1]; ++j) {
+            const I col = l_col_ind[j];
+            P slot;
+            #pragma omp atomic capture
+            slot = next[i]++;
+            full.col_ind[slot] = col;
+            full.values[slot]  = l_values[j];
+
+            if (col != i) {
+                #pragma omp atomic capture
+                slot = next[col]++;
+                full.col_ind[slot] = i;
+                full.values[slot]  = sign * l_values[j];
+            }
+        }
+    }
+
+    csr_sort_rows(full);
+}
+
+#endif // CSR_MATRIX_H
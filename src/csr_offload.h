@@ -0,0 +1,198 @@
+#ifndef CSR_OFFLOAD_H
+#define CSR_OFFLOAD_H
+
+#include <vector>
+#include <string>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// Device CSR SpMV (OpenMP target offload)
+// ---------------------------------------------------------------------------
+//
+// The matrix is uploaded once (target enter data) when the DeviceCsr is
+// built and stays resident until it is destroyed, so a call only moves the
+// vectors, or nothing at all when they are kept on the device as well
+// (map_vectors / update_input / update_result). The caller's arrays must
+// not move or be freed while they are mapped.
+//
+// Two kernels, as in the CUDA vector-CSR literature:
+//
+//   scalar: one lane (OpenMP simd lane, i.e. one GPU thread) per row;
+//           short rows, but a warp diverges on rows of different length
+//   vector: one warp per row (parallel for over rows, simd reduction over
+//           the row), coalesced loads of values / col_ind along the row
+//
+// DEVICE_KERNEL_AUTO takes the vector kernel when the mean row length fills
+// a warp. Without an offload device (or a compiler without offload
+// support) the target regions run on the host, which reports
+// on_host() == true: results stay correct, timings are not device numbers.
+//
+// Offload code is built by the OpenMP compiler flags (e.g. g++ -fopenmp
+// -foffload=nvptx-none, clang++ -fopenmp -fopenmp-targets=nvptx64); see the
+// OFFLOAD variable of the Makefile.
+
+enum DeviceKernel {
+    DEVICE_KERNEL_AUTO,
+    DEVICE_KERNEL_SCALAR,
+    DEVICE_KERNEL_VECTOR
+};
+
+// Mean row length from which the vector kernel is used (lanes of a warp)
+static const double DEVICE_VECTOR_MIN_ROW = 32.0;
+
+inline const char* device_kernel_name(DeviceKernel k) {
+    return k == DEVICE_KERNEL_VECTOR ? "vector" : k == DEVICE_KERNEL_SCALAR ? "scalar" : "auto";
+}
+
+inline DeviceKernel choose_device_kernel(const CsrMatrix& A, DeviceKernel requested) {
+    if (requested != DEVICE_KERNEL_AUTO) return requested;
+    const double mean = A.rows > 0 ? (double)A.nnz / A.rows : 0.0;
+    return mean >= DEVICE_VECTOR_MIN_ROW ? DEVICE_KERNEL_VECTOR : DEVICE_KERNEL_SCALAR;
+}
+
+class DeviceCsr {
+public:
+    // Uploads A; A must outlive the DeviceCsr together with its arrays
+    DeviceCsr(const CsrMatrix& A, DeviceKernel kernel)
+        : rows_(A.rows), cols_(A.cols), nnz_(A.nnz), row_ptr_(A.row_ptr.data()),
+          col_ind_(A.col_ind.data()), values_(A.values.data()),
+          kernel_(choose_device_kernel(A, kernel)) {
+        const int* row_ptr   = row_ptr_;
+        const int* col_ind   = col_ind_;
+        const double* values = values_;
+        const int rows = rows_, nnz = nnz_;
+
+        int on_host = 1;
+        #pragma omp target map(from: on_host)
+        {
+#ifdef _OPENMP
+            on_host = omp_is_initial_device();
+#endif
+        }
+        on_host_ = on_host != 0;
+
+        const double t0 = now();
+        #pragma omp target enter data map(to: row_ptr[0:rows + 1], col_ind[0:nnz], values[0:nnz])
+        upload_ms_ = (now() - t0) * 1000.0;
+        unused(row_ptr, col_ind, values);
+    }
+
+    ~DeviceCsr() {
+        const int* row_ptr   = row_ptr_;
+        const int* col_ind   = col_ind_;
+        const double* values = values_;
+        const int rows = rows_, nnz = nnz_;
+        #pragma omp target exit data map(delete: row_ptr[0:rows + 1], col_ind[0:nnz], values[0:nnz])
+        unused(row_ptr, col_ind, values);
+    }
+
+    DeviceCsr(const DeviceCsr&) = delete;
+    DeviceCsr& operator=(const DeviceCsr&) = delete;
+
+    DeviceKernel kernel() const { return kernel_; }
+    bool on_host() const { return on_host_; }
+    double upload_ms() const { return upload_ms_; }
+    double matrix_bytes() const { return 4.0 * (rows_ + 1) + 12.0 * nnz_; }
+
+    static int device_count() {
+#ifdef _OPENMP
+        return omp_get_num_devices();
+#else
+        return 0;
+#endif
+    }
+
+    // Keep v (cols entries, copied) and c (rows entries, allocated) on the
+    // device until unmap_vectors
+    void map_vectors(const double* v, double* c) const {
+        const int rows = rows_, cols = cols_;
+        #pragma omp target enter data map(to: v[0:cols]) map(alloc: c[0:rows])
+        unused(v, c);
+    }
+    void unmap_vectors(const double* v, double* c) const {
+        const int rows = rows_, cols = cols_;
+        #pragma omp target exit data map(delete: v[0:cols], c[0:rows])
+        unused(v, c);
+    }
+    void update_input(const double* v) const {
+        const int cols = cols_;
+        #pragma omp target update to(v[0:cols])
+        unused(v);
+    }
+    void update_result(double* c) const {
+        const int rows = rows_;
+        #pragma omp target update from(c[0:rows])
+        unused(c);
+    }
+
+    // c = A v on the device; v and c must be mapped (no transfer)
+    void multiply_mapped(const double* v, double* c) const {
+        const int* row_ptr   = row_ptr_;
+        const int* col_ind   = col_ind_;
+        const double* values = values_;
+        const int rows = rows_, cols = cols_, nnz = nnz_;
+
+        // The arrays are present, so these map clauses move no data
+        if (kernel_ == DEVICE_KERNEL_VECTOR) {
+            #pragma omp target teams distribute parallel for \
+                map(to: row_ptr[0:rows + 1], col_ind[0:nnz], values[0:nnz], v[0:cols]) \
+                map(from: c[0:rows])
+            for (int i = 0; i < rows; ++i) {
+                double sum = 0.0;
+                #pragma omp simd reduction(+:sum)
+                for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                    sum += values[j] * v[col_ind[j]];
+                }
+                c[i] = sum;
+            }
+        } else {
+            #pragma omp target teams distribute parallel for simd \
+                map(to: row_ptr[0:rows + 1], col_ind[0:nnz], values[0:nnz], v[0:cols]) \
+                map(from: c[0:rows])
+            for (int i = 0; i < rows; ++i) {
+                double sum = 0.0;
+                for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                    sum += values[j] * v[col_ind[j]];
+                }
+                c[i] = sum;
+            }
+        }
+    }
+
+    // c = A v with the vector transfers of the call included
+    void multiply(const std::vector<double>& v, std::vector<double>& c) const {
+        map_vectors(v.data(), c.data());
+        multiply_mapped(v.data(), c.data());
+        update_result(c.data());
+        unmap_vectors(v.data(), c.data());
+    }
+
+private:
+    // Data directives reference their arrays only when the compiler has an
+    // offload target; this keeps -Wunused quiet otherwise
+    template <typename... T>
+    static void unused(const T&...) {}
+
+    static double now() {
+#ifdef _OPENMP
+        return omp_get_wtime();
+#else
+        return 0.0;
+#endif
+    }
+
+    int rows_, cols_, nnz_;
+    const int* row_ptr_;
+    const int* col_ind_;
+    const double* values_;
+    DeviceKernel kernel_;
+    bool on_host_ = true;
+    double upload_ms_ = 0.0;
+};
+
+#endif // CSR_OFFLOAD_H
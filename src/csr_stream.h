@@ -0,0 +1,215 @@
+#ifndef CSR_STREAM_H
+#define CSR_STREAM_H
+
+#include <vector>
+#include <string>
+#include <future>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "matrix_io.h"
+
+// ---------------------------------------------------------------------------
+// Out-of-core SpMV streamed from the binary CSR cache
+// ---------------------------------------------------------------------------
+//
+// Only row_ptr and the vectors stay in memory. col_ind and values are read
+// in row panels into two buffers of budget / 2 bytes each: while the OpenMP
+// threads multiply panel k, an I/O thread (std::async) preads panel k + 1
+// into the other buffer, so reading and computing overlap and the resident
+// matrix data stays within the budget (a single row larger than half the
+// budget gets a panel of its own).
+//
+// The pages of a panel are dropped from the page cache once it has been
+// read (POSIX_FADV_DONTNEED), so every call reads from storage as it would
+// for a matrix larger than memory. Symmetric caches hold one triangle; the
+// mirrored entries are applied with atomic updates of c, since they can land
+// on rows of any panel and thread.
+
+template <typename P, typename I>
+class CsrStream {
+public:
+    CsrStream() : fd_(-1), sign_(0.0), io_ms_(0.0), wait_ms_(0.0), bytes_read_(0) {}
+    ~CsrStream() { if (fd_ >= 0) close(fd_); }
+
+    CsrStream(const CsrStream&) = delete;
+    CsrStream& operator=(const CsrStream&) = delete;
+
+    // Open a cache file whose header h (with layout l) has been validated
+    // and plan the panels for budget_bytes of panel buffers.
+    bool open(const std::string& cache_path, const CsrFileHeader& h, const CsrFileLayout& l,
+              size_t budget_bytes) {
+        header_ = h;
+        layout_ = l;
+        sign_   = h.flags == MTX_GENERAL ? 0.0 : (h.flags == MTX_SKEW_SYMMETRIC ? -1.0 : 1.0);
+        fd_ = ::open(cache_path.c_str(), O_RDONLY);
+        if (fd_ < 0) return false;
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        row_ptr_.resize(h.rows + 1);
+        if (!read_fully(row_ptr_.data(), (h.rows + 1) * sizeof(P), l.row_ptr_offset)) {
+            return false;
+        }
+
+        // Panels: as many rows as fit into one buffer, at least one row
+        const long long entry_bytes = sizeof(I) + sizeof(double);
+        const long long max_entries = std::max<long long>(1, budget_bytes / 2 / entry_bytes);
+        panel_begin_.assign(1, 0);
+        long long largest = 0;
+        while (panel_begin_.back() < h.rows) {
+            const long long r0 = panel_begin_.back();
+            const P limit = row_ptr_[r0] + static_cast<P>(max_entries);
+            long long r1 = std::upper_bound(row_ptr_.begin() + r0 + 1, row_ptr_.end(), limit) -
+                           row_ptr_.begin() - 1;
+            r1 = std::max(r1, r0 + 1);
+            largest = std::max<long long>(largest, row_ptr_[r1] - row_ptr_[r0]);
+            panel_begin_.push_back(r1);
+        }
+        for (int b = 0; b < 2; ++b) {
+            buffer_[b].col_ind.resize(largest);
+            buffer_[b].values.resize(largest);
+        }
+        return true;
+    }
+
+    int num_panels() const { return static_cast<int>(panel_begin_.size()) - 1; }
+    bool symmetric() const { return sign_ != 0.0; }
+    long long rows() const { return header_.rows; }
+    long long cols() const { return header_.cols; }
+    long long nnz() const { return header_.nnz; }
+
+    // Bytes of the two panel buffers (the resident part of the matrix
+    // besides row_ptr)
+    size_t buffer_bytes() const {
+        return 2 * buffer_[0].values.size() * (sizeof(I) + sizeof(double));
+    }
+
+    // Statistics since the last take_stats(): time inside pread, time the
+    // compute threads waited for a panel and bytes read.
+    void take_stats(double& io_ms, double& wait_ms, long long& bytes_read) {
+        io_ms      = io_ms_;
+        wait_ms    = wait_ms_;
+        bytes_read = bytes_read_;
+        io_ms_ = wait_ms_ = 0.0;
+        bytes_read_ = 0;
+    }
+
+    // c = A v, streaming every panel once. False on a read error.
+    bool multiply(const std::vector<double>& v, std::vector<double>& c) {
+        if (symmetric()) std::fill(c.begin(), c.end(), 0.0);
+        const int npanels = num_panels();
+        if (npanels == 0) return true;
+
+        std::future<bool> pending = std::async(std::launch::async, &CsrStream::read_panel,
+                                               this, 0, std::ref(buffer_[0]));
+        for (int k = 0; k < npanels; ++k) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            const bool ok = pending.get();
+            wait_ms_ += std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            if (!ok) return false;
+
+            if (k + 1 < npanels) {
+                pending = std::async(std::launch::async, &CsrStream::read_panel, this, k + 1,
+                                     std::ref(buffer_[(k + 1) % 2]));
+            }
+            multiply_panel(k, buffer_[k % 2], v.data(), c.data());
+        }
+        return true;
+    }
+
+private:
+    struct Buffer {
+        std::vector<I> col_ind;
+        std::vector<double> values;
+    };
+
+    bool read_fully(void* dst, size_t bytes, uint64_t offset) {
+        char* p = static_cast<char*>(dst);
+        while (bytes > 0) {
+            const ssize_t n = pread(fd_, p, bytes, offset);
+            if (n <= 0) return false;
+            p += n;
+            offset += n;
+            bytes -= n;
+        }
+        return true;
+    }
+
+    // Runs on the I/O thread; only touches the buffer of panel k and the
+    // I/O counters, which the compute side reads after get().
+    bool read_panel(int k, Buffer& b) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const P first = row_ptr_[panel_begin_[k]];
+        const P count = row_ptr_[panel_begin_[k + 1]] - first;
+        const uint64_t col_offset = layout_.col_ind_offset + (uint64_t)first * sizeof(I);
+        const uint64_t val_offset = layout_.values_offset + (uint64_t)first * sizeof(double);
+        const bool ok = read_fully(b.col_ind.data(), count * sizeof(I), col_offset) &&
+                        read_fully(b.values.data(), count * sizeof(double), val_offset);
+#ifdef POSIX_FADV_DONTNEED
+        posix_fadvise(fd_, col_offset, count * sizeof(I), POSIX_FADV_DONTNEED);
+        posix_fadvise(fd_, val_offset, count * sizeof(double), POSIX_FADV_DONTNEED);
+#endif
+        bytes_read_ += (long long)count * (sizeof(I) + sizeof(double));
+        io_ms_ += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        return ok;
+    }
+
+    void multiply_panel(int k, const Buffer& b, const double* v, double* c) {
+        const I r0 = static_cast<I>(panel_begin_[k]);
+        const I r1 = static_cast<I>(panel_begin_[k + 1]);
+        const P base = row_ptr_[r0];
+        const P* row_ptr = row_ptr_.data();
+        const I* col_ind = b.col_ind.data();
+        const double* values = b.values.data();
+
+        if (!symmetric()) {
+            #pragma omp parallel for schedule(runtime)
+            for (I i = r0; i < r1; ++i) {
+                double sum = 0.0;
+                for (P j = row_ptr[i] - base; j < row_ptr[i + 1] - base; ++j) {
+                    sum += values[j] * v[col_ind[j]];
+                }
+                c[i] = sum;
+            }
+            return;
+        }
+
+        const double sign = sign_;
+        #pragma omp parallel for schedule(runtime)
+        for (I i = r0; i < r1; ++i) {
+            const double vi = v[i];
+            double sum = 0.0;
+            for (P j = row_ptr[i] - base; j < row_ptr[i + 1] - base; ++j) {
+                const I col = col_ind[j];
+                sum += values[j] * v[col];
+                if (col != i) {
+                    #pragma omp atomic
+                    c[col] += sign * values[j] * vi;
+                }
+            }
+            #pragma omp atomic
+            c[i] += sum;
+        }
+    }
+
+    int fd_;
+    CsrFileHeader header_;
+    CsrFileLayout layout_;
+    double sign_;                        // 0: general, +-1: mirrored triangle
+    std::vector<P> row_ptr_;
+    std::vector<long long> panel_begin_; // num_panels + 1 row boundaries
+    Buffer buffer_[2];
+    double io_ms_;
+    double wait_ms_;
+    long long bytes_read_;
+};
+
+#endif // CSR_STREAM_H
@@ -0,0 +1,214 @@
+#ifndef CSR_TILED_H
+#define CSR_TILED_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// Column-tiled CSR
+// ---------------------------------------------------------------------------
+//
+// The columns are cut into vertical panels of panel_cols columns, so the
+// slice of v_in touched by one panel (panel_cols * 8 bytes) fits a chosen
+// cache budget. The panels are processed one after the other, every panel
+// in parallel over its rows, and each row adds its partial sum to c_out.
+//
+// Storage is panel-major: the entries of panel p are contiguous and only
+// its non-empty rows are listed, so short rows do not pay a row_ptr per
+// panel:
+//
+//   panel p rows:   k in [panel_row[p], panel_row[p + 1])
+//   row of k:       row_ind[k]
+//   entries of k:   [row_start[k], row_start[k + 1])  in col_ind / values
+
+struct TiledCsrMatrix {
+    int rows = 0;
+    int cols = 0;
+    int nnz  = 0;
+    int panel_cols = 0;
+    int num_panels = 0;
+    std::vector<int> panel_row;   // num_panels + 1 offsets into row_ind
+    std::vector<int> row_ind;     // non-empty rows of every panel
+    std::vector<int> row_start;   // row_ind.size() + 1 offsets into col_ind
+    std::vector<int> col_ind;
+    std::vector<double> values;
+};
+
+// Panel width for a cache budget in KB (v_in entries are 8 bytes).
+inline int tile_panel_cols(int cols, int tile_kb) {
+    const long long width = (long long)tile_kb * 1024 / sizeof(double);
+    return static_cast<int>(std::max(1LL, std::min<long long>(width, std::max(cols, 1))));
+}
+
+inline void build_tiled_csr(const CsrMatrix& A, int panel_cols, TiledCsrMatrix& T) {
+    const int* row_ptr = A.row_ptr.data();
+    const int* col_ind = A.col_ind.data();
+
+    T.rows = A.rows;
+    T.cols = A.cols;
+    T.nnz  = A.nnz;
+    T.panel_cols = std::max(1, panel_cols);
+    T.num_panels = std::max(1, (A.cols + T.panel_cols - 1) / T.panel_cols);
+    const int P = T.num_panels;
+    T.panel_row.assign(P + 1, 0);
+    T.col_ind.resize(A.nnz);
+    T.values.resize(A.nnz);
+
+    // Each thread converts a contiguous block of rows. Pass 1 counts the
+    // rows and entries it contributes to every panel; a scan in (panel,
+    // thread) order gives each (panel, thread) pair its output offsets, so
+    // the rows of a panel stay in increasing order.
+    std::vector<int> row_offset, nz_offset;
+    #pragma omp parallel num_threads(io_num_threads())
+    {
+        int nthreads = 1, tid = 0;
+#ifdef _OPENMP
+        nthreads = omp_get_num_threads();
+        tid      = omp_get_thread_num();
+#endif
+        #pragma omp single
+        {
+            row_offset.assign((size_t)nthreads * P, 0);
+            nz_offset.assign((size_t)nthreads * P, 0);
+        }
+
+        const int begin = static_cast<int>((long long)A.rows * tid / nthreads);
+        const int end   = static_cast<int>((long long)A.rows * (tid + 1) / nthreads);
+        int* my_rows = row_offset.data() + (size_t)tid * P;
+        int* my_nz   = nz_offset.data() + (size_t)tid * P;
+
+        for (int i = begin; i < end; ++i) {
+            int last = -1;
+            for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                const int p = col_ind[j] / T.panel_cols;
+                if (p != last) ++my_rows[p];
+                ++my_nz[p];
+                last = p;
+            }
+        }
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            int rows_so_far = 0, nz_so_far = 0;
+            for (int p = 0; p < P; ++p) {
+                T.panel_row[p] = rows_so_far;
+                for (int t = 0; t < nthreads; ++t) {
+                    const int r = row_offset[(size_t)t * P + p];
+                    const int z = nz_offset[(size_t)t * P + p];
+                    row_offset[(size_t)t * P + p] = rows_so_far;
+                    nz_offset[(size_t)t * P + p]  = nz_so_far;
+                    rows_so_far += r;
+                    nz_so_far   += z;
+                }
+            }
+            T.panel_row[P] = rows_so_far;
+            T.row_ind.resize(rows_so_far);
+            T.row_start.resize(rows_so_far + 1);
+            T.row_start[rows_so_far] = nz_so_far;
+        }
+
+        // Pass 2: scatter the row segments (columns are sorted, so every
+        // panel's part of a row is one contiguous run)
+        for (int i = begin; i < end; ++i) {
+            int last = -1;
+            for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                const int p = col_ind[j] / T.panel_cols;
+                if (p != last) {
+                    const int k = my_rows[p]++;
+                    T.row_ind[k]   = i;
+                    T.row_start[k] = my_nz[p];
+                    last = p;
+                }
+                const int slot = my_nz[p]++;
+                T.col_ind[slot] = col_ind[j];
+                T.values[slot]  = A.values[j];
+            }
+        }
+    }
+}
+
+// Panel by panel inside one parallel region; the implicit barrier of each
+// worksharing loop keeps the panels in order, and within a panel every row
+// appears once, so the += needs no atomics.
+inline void spmv_csr_tiled(const TiledCsrMatrix& T,
+                           const std::vector<double>& v,
+                           std::vector<double>& c) {
+    const int* panel_row = T.panel_row.data();
+    const int* row_ind   = T.row_ind.data();
+    const int* row_start = T.row_start.data();
+    const int* col_ind   = T.col_ind.data();
+    const double* values = T.values.data();
+    const double* v_in   = v.data();
+    double* c_out        = c.data();
+
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(static)
+        for (int i = 0; i < T.rows; ++i) {
+            c_out[i] = 0.0;
+        }
+
+        for (int p = 0; p < T.num_panels; ++p) {
+            #pragma omp for schedule(runtime)
+            for (int k = panel_row[p]; k < panel_row[p + 1]; ++k) {
+                double sum = 0.0;
+                for (int j = row_start[k]; j < row_start[k + 1]; ++j) {
+                    sum += values[j] * v_in[col_ind[j]];
+                }
+                c_out[row_ind[k]] += sum;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Panel width auto-tuner
+// ---------------------------------------------------------------------------
+//
+// Cache budgets from 64 KB upwards are doubled until a single panel covers
+// all columns (plain CSR order). Every candidate is built and timed on a
+// few trial SpMVs with the current OpenMP settings; the fastest one is
+// kept in T and its budget returned.
+
+inline int tune_tiled_csr(const CsrMatrix& A, TiledCsrMatrix& T) {
+    const int TRIAL_RUNS = 3;
+
+    std::vector<double> v(A.cols), c(A.rows);
+    for (int i = 0; i < A.cols; ++i) v[i] = std::sin(i + 1.0);
+
+    int best_kb = 0;
+    double best_ms = 0.0;
+    for (int kb = 64; ; kb *= 2) {
+        const int panel_cols = tile_panel_cols(A.cols, kb);
+        TiledCsrMatrix trial;
+        build_tiled_csr(A, panel_cols, trial);
+
+        spmv_csr_tiled(trial, v, c);   // warm-up
+        double ms = 0.0;
+        for (int run = 0; run < TRIAL_RUNS; ++run) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            spmv_csr_tiled(trial, v, c);
+            const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            const double run_ms = std::chrono::duration<double, std::milli>(end - start).count();
+            ms = (run == 0) ? run_ms : std::min(ms, run_ms);
+        }
+        std::cerr << "  tile " << kb << " KB (" << trial.num_panels << " panels): "
+                  << ms << " ms\n";
+
+        if (best_kb == 0 || ms < best_ms) {
+            best_kb = kb;
+            best_ms = ms;
+            std::swap(T, trial);
+        }
+        if (panel_cols >= A.cols) break;
+    }
+    return best_kb;
+}
+
+#endif // CSR_TILED_H
@@ -0,0 +1,175 @@
+#ifndef CSR_UPDATE_H
+#define CSR_UPDATE_H
+
+#include <vector>
+#include <algorithm>
+
+#include "csr_matrix.h"
+#include "bcsr.h"
+
+// ---------------------------------------------------------------------------
+// Value updates on a fixed sparsity pattern
+// ---------------------------------------------------------------------------
+//
+// When only the values change (time stepping), the structure is built once
+// and every step moves the new values through precomputed maps in O(nnz):
+//
+//   triplets --CsrValueMap--> CSR --DerivedValueMap--> reordered CSR, SELL,
+//                                                      BCSR, ...
+//
+// CsrValueMap gathers: CSR entry s takes the value of triplet source[s] - 1,
+// negated where source[s] < 0 (the mirrored half of a skew-symmetric
+// matrix). It is found by converting the triplets once with their own
+// numbers k + 1 as values, so it follows coo_to_csr / csr_expand_symmetric
+// whatever order they put the entries in; duplicate triplets stay separate
+// CSR entries, as in coo_to_csr.
+//
+// DerivedValueMap scatters: entry j of the parent CSR goes to slot
+// target[j] of the derived format's values. Formats that copy every value
+// to its own slot get the map from their builder run once on a tagged copy
+// (derived_value_map); BCSR, which adds duplicate entries into one slot,
+// has its own (bcsr_value_map). The derived arrays keep their padding zeros.
+
+struct CsrValueMap {
+    std::vector<int> source;    // per CSR entry: +-(triplet + 1)
+};
+
+struct DerivedValueMap {
+    std::vector<int> target;    // per parent entry: slot in the derived values
+    bool accumulate = false;    // entries share a slot: zero, then add
+};
+
+// values[k] = k + 1 (exact in a double up to 2^53)
+inline void csr_value_tags(std::vector<double>& values) {
+    const long long n = static_cast<long long>(values.size());
+    #pragma omp parallel for schedule(static) num_threads(io_num_threads())
+    for (long long k = 0; k < n; ++k) values[k] = static_cast<double>(k + 1);
+}
+
+// values = the triplet values (in file order) through the map
+inline void csr_set_values(const CsrValueMap& map, const std::vector<double>& triplet_values,
+                           std::vector<double>& values) {
+    const int* source  = map.source.data();
+    const double* in   = triplet_values.data();
+    const int n        = static_cast<int>(map.source.size());
+    #pragma omp parallel for schedule(static)
+    for (int s = 0; s < n; ++s) {
+        const int t = source[s];
+        values[s] = t > 0 ? in[t - 1] : -in[-t - 1];
+    }
+}
+
+// values += the triplet deltas (in file order) through the map
+inline void csr_add_deltas(const CsrValueMap& map, const std::vector<double>& triplet_deltas,
+                           std::vector<double>& values) {
+    const int* source  = map.source.data();
+    const double* in   = triplet_deltas.data();
+    const int n        = static_cast<int>(map.source.size());
+    #pragma omp parallel for schedule(static)
+    for (int s = 0; s < n; ++s) {
+        const int t = source[s];
+        values[s] += t > 0 ? in[t - 1] : -in[-t - 1];
+    }
+}
+
+// Structure of the triplets as CSR (expanded with sign * a for every
+// mirrored entry when expand is set) and the map of its values; csr gets
+// the values of the triplets.
+inline void coo_to_csr_mapped(const std::vector<Triplet>& triplets, int rows, int cols,
+                              bool expand, double sign, CsrMatrix& csr, CsrValueMap& map) {
+    std::vector<Triplet> tagged(triplets);
+    #pragma omp parallel for schedule(static) num_threads(io_num_threads())
+    for (long long k = 0; k < (long long)tagged.size(); ++k) {
+        tagged[k].val = static_cast<double>(k + 1);
+    }
+    coo_to_csr(tagged, rows, cols, csr);
+    std::vector<Triplet>().swap(tagged);
+    if (expand) {
+        CsrMatrix full;
+        csr_expand_symmetric(csr, sign, full);
+        csr = std::move(full);
+    }
+
+    map.source.resize(csr.nnz);
+    #pragma omp parallel for schedule(static) num_threads(io_num_threads())
+    for (int s = 0; s < csr.nnz; ++s) map.source[s] = static_cast<int>(csr.values[s]);
+
+    std::vector<double> values(triplets.size());
+    for (size_t k = 0; k < triplets.size(); ++k) values[k] = triplets[k].val;
+    csr_set_values(map, values, csr.values);
+}
+
+// Map of a derived format: build(tagged, values) builds it from a copy of
+// parent whose values are the tags and hands back the format's values.
+// False if the builder does not put every entry into a slot of its own.
+template <typename Build>
+inline bool derived_value_map(const CsrMatrix& parent, Build build, DerivedValueMap& map) {
+    CsrMatrix tagged = parent;
+    csr_value_tags(tagged.values);
+    std::vector<double> derived;
+    build(tagged, derived);
+
+    map.target.assign(parent.nnz, -1);
+    map.accumulate = false;
+    long long placed = 0;
+    for (size_t s = 0; s < derived.size(); ++s) {
+        const double t = derived[s];
+        if (t == 0.0) continue;                       // padding
+        const long long j = static_cast<long long>(t) - 1;
+        if (t != static_cast<double>(j + 1) || j < 0 || j >= parent.nnz ||
+            map.target[j] >= 0) {
+            return false;
+        }
+        map.target[j] = static_cast<int>(s);
+        ++placed;
+    }
+    return placed == parent.nnz;
+}
+
+// Map of build_bcsr(A, B.R, B.C, B): the slot of every entry in its block,
+// found like build_bcsr does; duplicate entries make it accumulate.
+inline void bcsr_value_map(const CsrMatrix& A, const BcsrMatrix& B, DerivedValueMap& map) {
+    const int R = B.R, C = B.C;
+    map.target.resize(A.nnz);
+    int duplicates = 0;
+    #pragma omp parallel for schedule(dynamic, 64) num_threads(io_num_threads()) \
+        reduction(+:duplicates)
+    for (int bi = 0; bi < B.block_rows; ++bi) {
+        const int* first = B.bcol_ind.data() + B.brow_ptr[bi];
+        const int* last  = B.bcol_ind.data() + B.brow_ptr[bi + 1];
+        const int row_end = std::min(A.rows, (bi + 1) * R);
+        for (int i = bi * R; i < row_end; ++i) {
+            for (int j = A.row_ptr[i]; j < A.row_ptr[i + 1]; ++j) {
+                const int col = A.col_ind[j];
+                const int k = B.brow_ptr[bi] + static_cast<int>(
+                    std::lower_bound(first, last, col / C) - first);
+                map.target[j] = k * R * C + (i - bi * R) * C + (col % C);
+                if (j > A.row_ptr[i] && A.col_ind[j - 1] == col) ++duplicates;
+            }
+        }
+    }
+    map.accumulate = duplicates > 0;
+}
+
+// derived[target[j]] = parent.values[j]. Entries sharing a slot (BCSR
+// duplicates) are in the same row, so the rows can be split between threads.
+// The per-step functions use the caller's OpenMP thread count.
+inline void refresh_derived_values(const CsrMatrix& parent, const DerivedValueMap& map,
+                                   std::vector<double>& derived) {
+    const int* row_ptr   = parent.row_ptr.data();
+    const int* target    = map.target.data();
+    const double* values = parent.values.data();
+    double* out          = derived.data();
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < parent.rows; ++i) {
+        if (map.accumulate) {
+            for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) out[target[j]] = 0.0;
+            for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) out[target[j]] += values[j];
+        } else {
+            for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) out[target[j]] = values[j];
+        }
+    }
+}
+
+#endif // CSR_UPDATE_H
@@ -0,0 +1,243 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <omp.h>
+#include <mpi.h>
+
+#include "matrix_io.h"
+#include "bench.h"
+#include "spmv_common.h"
+#include "verify.h"
+#include "dist_csr.h"
+
+using namespace std;
+
+// MPI + OpenMP hybrid SpMV: one process per socket or node, OpenMP threads
+// inside each process. Rank 0 loads the matrix and distributes nnz-balanced
+// row blocks (dist_csr.h); every call exchanges the needed v_in entries with
+// the neighbour ranks while the local part of the block is multiplied.
+
+static int run_mpi_benchmark(int argc, char* argv[], int rank, int nranks) {
+    // Expected CLI:
+    //   mpirun -np R ./spmv_mpi <matrix.mtx> <schedule_type> <chunk_size> <num_threads> [options]
+    if (argc < 5) {
+        if (rank == 0) {
+            cerr << "Usage: mpirun -np <ranks> " << argv[0]
+                 << " <matrix.mtx> <schedule_type> <chunk_size> <num_threads> [options]\n";
+            cerr << "  schedule_type: static, dynamic, guided (OpenMP schedule inside a rank)\n";
+            cerr << "  num_threads:   OpenMP threads per rank\n";
+            cerr << "Options:\n";
+            cerr << "  --overlap on|off         overlap the halo exchange with the local part\n";
+            cerr << "                           of every row block (default: on)\n";
+            cerr << "  --verify                 check the result against a Kahan-summed CSR\n";
+            cerr << "                           reference on rank 0 (keeps the whole matrix there)\n";
+            cerr << "  --warmup N               untimed calls before timing (default: 1)\n";
+            cerr << "  --runs N                 minimum number of timed calls (default: 10)\n";
+            cerr << "  --min-time MS            time calls until they add up to MS ms\n";
+            cerr << "  --report csv|json        statistics, GFLOP/s, GB/s and build / host\n";
+            cerr << "                           metadata instead of the per-run CSV line\n";
+            cerr << "  --seed N                 seed of the random input vector (default: random)\n";
+            cerr << "  --verify-tol T           scaled error tolerance of --verify (default: 1e-10)\n";
+        }
+        return 1;
+    }
+
+    string filename     = argv[1];
+    string schedule_str = argv[2];
+    int chunk_size      = 0;
+    int num_threads     = 0;
+
+    try {
+        chunk_size  = stoi(argv[3]);
+        num_threads = stoi(argv[4]);
+    } catch (const std::exception&) {
+        if (rank == 0) cerr << "Error: chunk_size and num_threads must be integer values.\n";
+        return 1;
+    }
+
+    // Every rank parses the same command line, so errors are seen by all of
+    // them; only rank 0 prints
+    bool overlap = true;
+    BenchOptions bench;
+    for (int i = 5; i < argc; ++i) {
+        const string opt = argv[i];
+        bool bench_ok = true;
+        if (bench_parse_option(argc, argv, i, bench, bench_ok)) {
+            if (!bench_ok) return 1;
+        } else if (opt == "--overlap" && i + 1 < argc) {
+            const string mode = argv[++i];
+            if (mode != "on" && mode != "off") {
+                if (rank == 0) cerr << "Error: invalid --overlap. Use: on, off\n";
+                return 1;
+            }
+            overlap = (mode == "on");
+        } else {
+            if (rank == 0) cerr << "Error: unknown or incomplete option " << opt << "\n";
+            return 1;
+        }
+    }
+
+    omp_sched_t sched_kind = omp_sched_static;
+    if (schedule_str == "static") {
+        sched_kind = omp_sched_static;
+    } else if (schedule_str == "dynamic") {
+        sched_kind = omp_sched_dynamic;
+    } else if (schedule_str == "guided") {
+        sched_kind = omp_sched_guided;
+    } else {
+        if (rank == 0) cerr << "Error: invalid scheduling type. Use: static, dynamic, guided\n";
+        return 1;
+    }
+    omp_set_num_threads(num_threads);
+    omp_set_schedule(sched_kind, chunk_size);
+
+    // --- Rank 0 loads the matrix (32-bit indices), everyone learns the outcome ---
+    CsrMatrix A;
+    int ok = 1;
+    if (rank == 0) {
+        CsrIndexWidth width = CSR_INDEX_32;
+        ok = matrix_index_width(filename, SYM_EXPAND, width) && load_matrix(filename, A);
+        if (ok && width != CSR_INDEX_32) {
+            cerr << "Error: spmv_mpi supports matrices with 32-bit indices only.\n";
+            ok = 0;
+        }
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!ok) return 1;
+
+    const double setup_start = MPI_Wtime();
+    DistCsrMatrix d;
+    dist_csr_scatter(A, MPI_COMM_WORLD, d);
+    const double setup_ms = (MPI_Wtime() - setup_start) * 1000.0;
+
+    // --- Random input vector in [-1000, 1000], generated on rank 0 and
+    // scattered to the owners of each slice ---
+    vector<int> col_counts(nranks), row_counts(nranks);
+    for (int r = 0; r < nranks; ++r) {
+        col_counts[r] = d.col_offsets[r + 1] - d.col_offsets[r];
+        row_counts[r] = d.row_offsets[r + 1] - d.row_offsets[r];
+    }
+    vector<double> v_full;
+    if (rank == 0) {
+        v_full.resize(d.global_cols);
+        fill_random_input(v_full, bench_seed(bench, random_device()()));
+    }
+    vector<double> v_local(d.local_cols());
+    MPI_Scatterv(v_full.data(), col_counts.data(), d.col_offsets.data(), MPI_DOUBLE,
+                 v_local.data(), d.local_cols(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (!bench.verify) {
+        A = CsrMatrix();
+        vector<double>().swap(v_full);
+    }
+
+    vector<double> c_local(d.local_rows(), 0.0);
+
+    // --- Warm-up, then timed calls; a call starts at a barrier and its time
+    // is that of the slowest rank, so all ranks record the same times ---
+    const vector<double> times_ms = bench_measure(bench,
+        [&]() {
+            MPI_Barrier(MPI_COMM_WORLD);
+            dist_spmv(d, v_local, c_local, overlap);
+        },
+        []() {}, []() {},
+        [](double ms) {
+            double slowest = ms;
+            MPI_Allreduce(&ms, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            return slowest;
+        });
+
+    // --- Decomposition statistics: nnz balance and halo size ---
+    long long mine[4] = {(long long)d.local.nnz + d.remote.nnz, (long long)d.ghost.size(),
+                         (long long)d.recv_ranks.size(), (long long)d.remote.nnz};
+    vector<long long> all(4 * nranks);
+    MPI_Gather(mine, 4, MPI_LONG_LONG, all.data(), 4, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    long long global_nnz = 0, halo_entries = 0, max_nnz = 0, max_ghost = 0, max_neighbours = 0;
+    long long remote_nnz = 0;
+    for (int r = 0; r < nranks; ++r) {
+        global_nnz    += all[4 * r];
+        halo_entries  += all[4 * r + 1];
+        remote_nnz    += all[4 * r + 3];
+        max_nnz        = max(max_nnz, all[4 * r]);
+        max_ghost      = max(max_ghost, all[4 * r + 1]);
+        max_neighbours = max(max_neighbours, all[4 * r + 2]);
+    }
+
+    // --- Optional check against the Kahan reference (rank 0) ---
+    const double verify_tol = bench.verify_tol > 0.0 ? bench.verify_tol : VERIFY_TOL_FP64;
+    VerifyResult verify_result;
+    if (bench.verify) {
+        vector<double> c_full(rank == 0 ? d.global_rows : 0);
+        MPI_Gatherv(c_local.data(), d.local_rows(), MPI_DOUBLE, c_full.data(),
+                    row_counts.data(), d.row_offsets.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            verify_result = verify_spmv(A, v_full, 1, c_full, verify_tol);
+        }
+    }
+
+    if (rank != 0) return 0;
+
+    const double mean_nnz = (double)global_nnz / nranks;
+    cerr << "MPI: " << nranks << " ranks x " << num_threads << " threads, setup "
+         << setup_ms << " ms; nnz per rank max " << max_nnz << " (imbalance "
+         << (mean_nnz > 0.0 ? max_nnz / mean_nnz : 1.0) << "), "
+         << 100.0 * remote_nnz / max(1LL, global_nnz) << "% of nnz on ghost columns\n";
+    cerr << "Halo per SpMV: " << halo_entries << " entries (" << 8.0 * halo_entries / 1048576.0
+         << " MB), at most " << max_ghost << " ghosts and " << max_neighbours
+         << " neighbours per rank\n";
+
+    const string matrix_name  = extract_matrix_name(filename);
+    const string kernel_label = string(overlap ? "mpi-overlap:" : "mpi-blocking:") +
+                                schedule_str;
+    if (bench.verify && !report_verify(kernel_label, verify_result, verify_tol, 1)) {
+        return 1;
+    }
+    if (!bench.report.empty()) {
+        BenchReport report;
+        report.matrix   = matrix_name;
+        report.kernel   = kernel_label;
+        report.chunk    = chunk_size;
+        report.threads  = num_threads;
+        report.rows     = d.global_rows;
+        report.cols     = d.global_cols;
+        report.nnz      = global_nnz;
+        report.flops    = 2.0 * global_nnz;
+        report.bytes    = 4.0 * (d.global_rows + 1) + 12.0 * global_nnz +
+                          8.0 * ((double)d.global_cols + d.global_rows);
+        report.warmup   = bench.warmup;
+        report.times_ms = times_ms;
+        report.extra.push_back(make_pair("ranks", (double)nranks));
+        report.extra.push_back(make_pair("halo_bytes", 8.0 * halo_entries));
+        report.extra.push_back(make_pair("nnz_imbalance", mean_nnz > 0.0 ? max_nnz / mean_nnz
+                                                                         : 1.0));
+        bench_print_report(cout, bench.report, report);
+        return 0;
+    }
+
+    // matrix,schedule,chunk,threads,ranks,run1,...
+    cout << matrix_name << "," << kernel_label << "," << chunk_size << "," << num_threads
+         << "," << nranks;
+    for (size_t run = 0; run < times_ms.size(); ++run) {
+        cout << "," << times_ms[run];
+    }
+    cout << "\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Only the master thread of each rank calls MPI
+    int provided = 0;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank = 0, nranks = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+    if (provided < MPI_THREAD_FUNNELED && rank == 0) {
+        cerr << "Warning: the MPI library does not provide MPI_THREAD_FUNNELED.\n";
+    }
+
+    const int status = run_mpi_benchmark(argc, argv, rank, nranks);
+    MPI_Finalize();
+    return status;
+}
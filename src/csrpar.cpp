@@ -5,110 +5,882 @@
 #include <string>
 #include <algorithm>
 #include <random>
+#include <cmath>
+#include <memory>
 #include <omp.h>
 
+#include "matrix_io.h"
+#include "bench.h"
+#include "spmv_common.h"
+#include "csr_kernels.h"
+#include "kernel_registry.h"
+#include "autotune.h"
+#include "verify.h"
+#include "sell.h"
+#include "bcsr.h"
+#include "csr_delta.h"
+#include "numa.h"
+#include "spmm.h"
+#include "csr_tiled.h"
+#include "reorder.h"
+#include "thread_team.h"
+#include "work_steal.h"
+#include "perf_counters.h"
+#include "krylov.h"
+#include "csr_stream.h"
+#include "matrix_powers.h"
+#include "csr_offload.h"
+#include "csr_update.h"
+
 using namespace std;
 
-struct Triplet {
-    int row;
-    int col;
-    double val;
+// Precision of the CSR kernels: matrix values / vectors and accumulation
+enum Precision {
+    PREC_FP64,          // double values, double vectors
+    PREC_FP32_ACC64,    // float values, double vectors and accumulation
+    PREC_FP32           // float values, float vectors and accumulation
 };
 
-bool compareTriplets(const Triplet& a, const Triplet& b) {
-    if (a.row < b.row) return true;
-    if (a.row == b.row) return a.col < b.col;
-    return false;
-}
+// State kept across the configurations of a sweep: the loaded matrix, the
+// seed of the input vector (so every configuration multiplies the same
+// vector) and what is still bound / already printed.
+struct BenchmarkContext {
+    bool reuse = false;              // keep csr for later configurations
+    bool loaded = false;
+    string filename;
+    SymmetricStorage storage = SYM_EXPAND;
+    CsrMatrix csr;
+    unsigned seed;
+    int bound_threads = 0;           // OpenMP threads pinned by the last run
+    bool header_printed = false;     // --report csv header already written
 
-struct CsrMatrix {
-    int rows = 0;
-    int cols = 0;
-    int nnz  = 0;
-    vector<int> row_ptr;
-    vector<int> col_ind;
-    vector<double> values;
+    BenchmarkContext() : seed(random_device()()) {}
 };
 
-// Sequential SpMV in CSR format (used for warm-up or debugging)
-void spmv_csr_sequential(const CsrMatrix& A,
-                         const vector<double>& v,
-                         vector<double>& c) {
-    const int* row_ptr   = A.row_ptr.data();
-    const int* col_ind   = A.col_ind.data();
-    const double* values = A.values.data();
-    const double* v_in   = v.data();
-    double* c_out        = c.data();
+// Columns every result line of a run shares (see bench_print_result)
+static BenchReport result_columns(const string& filename, int chunk_size, int num_threads,
+                                  ThreadBinding binding, long long rows, long long cols,
+                                  long long nnz) {
+    BenchReport r;
+    r.matrix  = extract_matrix_name(filename);
+    r.chunk   = chunk_size;
+    r.threads = num_threads;
+    r.bind    = thread_binding_name(binding);
+    r.rows    = rows;
+    r.cols    = cols;
+    r.nnz     = nnz;
+    return r;
+}
+
+// Benchmark of a matrix that needs wider indices than CsrMatrix: only the
+// runtime-schedule CSR kernel is templated on the index types (the work
+// splits, derived formats and solvers keep int row blocks and offsets), so
+// run_benchmark rejects everything else before it gets here. The matrix is
+// not kept in the sweep context.
+template <typename P, typename I>
+static int run_wide_benchmark(const string& filename, const string& kernel_label,
+                              int chunk_size, int num_threads, ThreadBinding binding,
+                              const BenchOptions& bench, BenchmarkContext& ctx) {
+    BasicCsrMatrix<double, P, I> csr;
+    if (!load_matrix(filename, csr)) {
+        return 1;
+    }
+    cerr << "Index width: " << 8 * sizeof(P) << "-bit row offsets, " << 8 * sizeof(I)
+         << "-bit column indices (" << csr.nnz << " nonzeros)\n";
+
+    vector<double> v_input(csr.cols);
+    fill_random_input(v_input, bench_seed(bench, ctx.seed));
+    vector<double> c_output(csr.rows, 0.0);
 
-    const int rows = A.rows;
+    if (binding != BIND_NONE) {
+        vector<vector<int> > cpu_sets;
+        if (!bind_threads(binding, num_threads, cpu_sets)) {
+            cerr << "Warning: thread binding is not supported here; running unbound.\n";
+            binding = BIND_NONE;
+        } else {
+            ctx.bound_threads = num_threads;
+            numa_first_touch(csr, nullptr, num_threads, v_input, c_output);
+        }
+    }
 
-    for (int i = 0; i < rows; ++i) {
-        double sum = 0.0;
-        const int row_start = row_ptr[i];
-        const int row_end   = row_ptr[i + 1];
-        for (int j = row_start; j < row_end; ++j) {
-            sum += values[j] * v_in[col_ind[j]];
+    const vector<double> times_ms =
+        bench_measure(bench, [&]() { spmv_csr_parallel(csr, v_input, c_output); });
+
+    if (bench.verify) {
+        const double tol = bench.verify_tol > 0.0 ? bench.verify_tol : VERIFY_TOL_FP64;
+        if (!report_verify(kernel_label, verify_spmv(csr, v_input, 1, c_output, tol), tol, 1)) {
+            return 1;
         }
-        c_out[i] = sum;
     }
+
+    const double bytes = (double)sizeof(P) * (csr.rows + 1) + (sizeof(I) + 8.0) * csr.nnz +
+                         8.0 * ((double)csr.cols + csr.rows);
+    bench_print_result(cout, bench,
+                       result_columns(filename, chunk_size, num_threads, binding, csr.rows,
+                                      csr.cols, csr.nnz),
+                       kernel_label, 2.0 * csr.nnz, bytes, times_ms,
+                       vector<pair<string, double> >(), ctx.header_printed);
+    return 0;
 }
 
-// Parallel SpMV (CSR format) using schedule(runtime)
-// The actual OpenMP schedule and chunk size are configured via omp_set_schedule()
-// and omp_set_num_threads() in main().
-void spmv_csr_parallel(const CsrMatrix& A,
-                       const vector<double>& v,
-                       vector<double>& c) {
-    const int* row_ptr   = A.row_ptr.data();
-    const int* col_ind   = A.col_ind.data();
-    const double* values = A.values.data();
-    const double* v_in   = v.data();
-    double* c_out        = c.data();
+// --stream: out-of-core SpMV over the binary cache (csr_stream.h) with
+// offset / index types P / I as recorded in the cache.
+template <typename P, typename I>
+static int run_stream_benchmark(const string& filename, const string& cache_path,
+                                const CsrFileHeader& h, const CsrFileLayout& l,
+                                const string& kernel_label, int chunk_size, int num_threads,
+                                ThreadBinding binding, int stream_mb,
+                                const BenchOptions& bench, BenchmarkContext& ctx) {
+    CsrStream<P, I> stream;
+    if (!stream.open(cache_path, h, l, (size_t)stream_mb << 20)) {
+        cerr << "Error: cannot read CSR cache " << cache_path << "\n";
+        return 1;
+    }
+    cerr << "Streaming " << cache_path << ": " << stream.num_panels() << " panels, "
+         << stream.buffer_bytes() / 1048576.0 << " MB of panel buffers (budget "
+         << stream_mb << " MB)" << (stream.symmetric() ? ", symmetric triangle" : "")
+         << "\n";
+    if (stream.buffer_bytes() > ((size_t)stream_mb << 20)) {
+        cerr << "Warning: the longest row does not fit half the budget; "
+                "its panel exceeds --stream.\n";
+    }
+
+    if (binding != BIND_NONE) {
+        vector<vector<int> > cpu_sets;
+        if (!bind_threads(binding, num_threads, cpu_sets)) {
+            cerr << "Warning: thread binding is not supported here; running unbound.\n";
+            binding = BIND_NONE;
+        } else {
+            ctx.bound_threads = num_threads;
+        }
+    }
+
+    vector<double> v_input(stream.cols());
+    fill_random_input(v_input, bench_seed(bench, ctx.seed));
+    vector<double> c_output(stream.rows(), 0.0);
+
+    // I/O statistics of the timed calls only
+    double io_ms = 0.0, wait_ms = 0.0;
+    long long bytes_read = 0;
+    bool failed = false;
+    const vector<double> times_ms = bench_measure(bench,
+        [&]() { if (!failed && !stream.multiply(v_input, c_output)) failed = true; },
+        [&]() { stream.take_stats(io_ms, wait_ms, bytes_read); },
+        [&]() { stream.take_stats(io_ms, wait_ms, bytes_read); });
+    if (failed) {
+        cerr << "Error: reading CSR cache " << cache_path << " failed\n";
+        return 1;
+    }
+
+    const double calls = (double)times_ms.size();
+    double total_ms = 0.0;
+    for (size_t run = 0; run < times_ms.size(); ++run) total_ms += times_ms[run];
+    cerr << "Streaming per SpMV: " << bytes_read / calls / 1048576.0 << " MB read in "
+         << io_ms / calls << " ms, compute waited " << wait_ms / calls << " ms of "
+         << total_ms / calls << " ms\n";
 
-    const int rows = A.rows;
+    // The reference needs the whole matrix in memory
+    if (bench.verify) {
+        BasicCsrMatrix<double, P, I> csr;
+        if (!load_matrix(filename, csr)) {
+            return 1;
+        }
+        const double tol = bench.verify_tol > 0.0 ? bench.verify_tol : VERIFY_TOL_FP64;
+        if (!report_verify(kernel_label, verify_spmv(csr, v_input, 1, c_output, tol), tol, 1)) {
+            return 1;
+        }
+    }
 
-    // Outer loop over rows is parallelized.
-    // Each thread processes a subset of rows independently.
-    #pragma omp parallel for schedule(runtime)
-    for (int i = 0; i < rows; ++i) {
-        double sum = 0.0;
-        const int row_start = row_ptr[i];
-        const int row_end   = row_ptr[i + 1];
+    // Symmetric triangle: every off-diagonal entry counts twice (the
+    // diagonal is taken as full, the stream never holds all of col_ind)
+    const long long nnz = stream.nnz();
+    const double flops  = 2.0 * (stream.symmetric() ? 2 * nnz - stream.rows() : nnz);
+    const double bytes  = (double)sizeof(P) * (stream.rows() + 1) + (sizeof(I) + 8.0) * nnz +
+                          8.0 * ((double)stream.cols() + stream.rows());
+    vector<pair<string, double> > extra;
+    extra.push_back(make_pair("io_ms", io_ms / calls));
+    extra.push_back(make_pair("io_wait_ms", wait_ms / calls));
+    bench_print_result(cout, bench,
+                       result_columns(filename, chunk_size, num_threads, binding,
+                                      stream.rows(), stream.cols(), nnz),
+                       kernel_label, flops, bytes, times_ms, extra, ctx.header_printed);
+    return 0;
+}
 
-        for (int j = row_start; j < row_end; ++j) {
-            sum += values[j] * v_in[col_ind[j]];
+// Validate (or build, which needs the matrix in memory once) the cache of
+// filename and stream it with the index types it was written with.
+static int run_stream(const string& filename, const string& kernel_label, int chunk_size,
+                      int num_threads, ThreadBinding binding, int stream_mb,
+                      const BenchOptions& bench, BenchmarkContext& ctx) {
+    struct stat source;
+    if (stat(filename.c_str(), &source) != 0) {
+        cerr << "Error: could not open file " << filename << "\n";
+        return 1;
+    }
+    const string cache_path = csr_cache_path(filename);
+    CsrFileHeader h;
+    CsrFileLayout l;
+    if (!read_csr_cache_header(cache_path, source, h, l)) {
+        MtxHeader header;
+        if (!read_matrix_market_header(filename, header)) {
+            return 1;
+        }
+        cerr << "Note: no valid CSR cache for --stream; building " << cache_path
+             << " (this loads the matrix once).\n";
+        MtxSymmetry symmetry;
+        bool ok;
+        const CsrIndexWidth width = csr_index_width(header.rows, header.cols, header.nnz);
+        if (width == CSR_INDEX_32) {
+            CsrMatrix stored;
+            ok = load_matrix_stored(filename, stored, symmetry);
+        } else if (width == CSR_OFFSET_64) {
+            CsrMatrix64 stored;
+            ok = load_matrix_stored(filename, stored, symmetry);
+        } else {
+            CsrMatrix64x64 stored;
+            ok = load_matrix_stored(filename, stored, symmetry);
+        }
+        if (!ok) {
+            return 1;
+        }
+        if (!read_csr_cache_header(cache_path, source, h, l)) {
+            cerr << "Error: --stream needs the CSR cache " << cache_path
+                 << ", which could not be written.\n";
+            return 1;
         }
+    }
+
+    if (h.offset_bytes == 4 && h.index_bytes == 4) {
+        return run_stream_benchmark<int, int>(filename, cache_path, h, l, kernel_label,
+                                              chunk_size, num_threads, binding, stream_mb,
+                                              bench, ctx);
+    } else if (h.index_bytes == 4) {
+        return run_stream_benchmark<long long, int>(filename, cache_path, h, l, kernel_label,
+                                                    chunk_size, num_threads, binding,
+                                                    stream_mb, bench, ctx);
+    }
+    return run_stream_benchmark<long long, long long>(filename, cache_path, h, l,
+                                                      kernel_label, chunk_size, num_threads,
+                                                      binding, stream_mb, bench, ctx);
+}
 
-        // No race condition: each thread writes to a distinct c_out[i]
-        c_out[i] = sum;
+// Registered kernels, one per line (./spmv --kernel list)
+static void print_kernel_list(ostream& out) {
+    const vector<KernelEntry>& registry = kernel_registry();
+    for (size_t k = 0; k < registry.size(); ++k) {
+        out << registry[k].name << string(max<size_t>(2, 16 - registry[k].name.size()), ' ')
+            << registry[k].description << "\n";
     }
 }
 
-// Helper: extract matrix name from full path
-// Example: "/home/.../bcsstk17/bcsstk17.mtx" -> "bcsstk17"
-static string extract_matrix_name(const string& path) {
-    // Remove directory part
-    size_t pos = path.find_last_of("/\\");
-    string filename = (pos == string::npos) ? path : path.substr(pos + 1);
+// --tune: the plan cached next to the matrix if it was tuned for the same
+// source, host, thread budget and reordering, otherwise analyse the matrix,
+// time the candidate kernels and store the winner.
+static bool select_tuned_plan(const string& filename, const CsrMatrix& csr,
+                              const string& reorder, int chunk_size, int max_threads,
+                              bool retune, const KernelOptions& base,
+                              const vector<double>& v_input, TunedPlan& plan) {
+    struct stat source;
+    if (stat(filename.c_str(), &source) != 0) {
+        cerr << "Error: cannot stat " << filename << "\n";
+        return false;
+    }
+    TunedPlanKey key;
+    key.source_size  = source.st_size;
+    key.source_mtime = source.st_mtime;
+    key.host         = bench_host_name();
+    key.max_threads  = max_threads;
+    key.reorder      = reorder;
+
+    const string plan_path = tuned_plan_path(filename);
+    if (!retune && read_tuned_plan(plan_path, key, plan)) {
+        cerr << "Plan: " << plan.kernel << ":" << plan.schedule << ", " << plan.threads
+             << " threads (cached in " << plan_path << ", tuned " << plan.ms << " ms)\n";
+        return true;
+    }
+
+    MatrixFeatures features;
+    analyze_matrix(csr, features);
+    print_matrix_features(cerr, features);
+    vector<TuneCandidate> candidates;
+    tune_candidates(features, candidates);
 
-    // Remove ".mtx" extension if present
-    const string ext = ".mtx";
-    if (filename.size() > ext.size() &&
-        filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0) {
-        filename.erase(filename.size() - ext.size(), ext.size());
+    cerr << "Tuning " << candidates.size() << " kernels up to " << max_threads
+         << " threads:\n";
+    const double start = omp_get_wtime();
+    if (!tune_plan(csr, candidates, max_threads, chunk_size, base, v_input, plan)) {
+        cerr << "Error: no candidate kernel could be built for this matrix.\n";
+        return false;
+    }
+    cerr << "Plan: " << plan.kernel << ":" << plan.schedule << ", " << plan.threads
+         << " threads, " << plan.ms << " ms (tuned in " << (omp_get_wtime() - start) * 1000.0
+         << " ms)\n";
+    if (!write_tuned_plan(plan_path, key, plan)) {
+        cerr << "Warning: could not write tuned plan " << plan_path << "\n";
     }
-    return filename;
+    return true;
 }
 
-int main(int argc, char* argv[]) {
+// Pin the OpenMP threads for the modes that build their own data (--kernel,
+// --powers), which therefore get no first-touch placement
+static ThreadBinding bind_without_placement(ThreadBinding binding, int num_threads,
+                                            const char* mode, BenchmarkContext& ctx) {
+    if (binding == BIND_NONE) return binding;
+    vector<vector<int> > cpu_sets;
+    if (!bind_threads(binding, num_threads, cpu_sets)) {
+        cerr << "Warning: thread binding is not supported here; running unbound.\n";
+        return BIND_NONE;
+    }
+    ctx.bound_threads = num_threads;
+    cerr << "Note: with " << mode << " the OpenMP threads are pinned, "
+            "without first-touch placement.\n";
+    return binding;
+}
+
+// --kernel: every named engine of the registry (kernel_registry.h) on the
+// same matrix and input vector, one result line each; the other engines are
+// compared with the result of the first one, or each one is checked against
+// the Kahan reference with --verify.
+static int run_kernels(const CsrMatrix& csr, const vector<double>& v_input,
+                       const vector<string>& kernel_names, const KernelOptions& kernel_opts,
+                       const string& filename, const string& schedule_str, int chunk_size,
+                       int num_threads, ThreadBinding binding, const BenchOptions& bench,
+                       BenchmarkContext& ctx) {
+    binding = bind_without_placement(binding, num_threads, "--kernel", ctx);
+
+    const BenchReport columns = result_columns(filename, chunk_size, num_threads, binding,
+                                               csr.rows, csr.cols, csr.nnz);
+    vector<double> c_output(csr.rows, 0.0), c_reference;
+    string reference_label;
+    for (size_t k = 0; k < kernel_names.size(); ++k) {
+        const KernelEntry* entry = find_kernel(kernel_names[k]);
+        const double t0 = omp_get_wtime();
+        unique_ptr<SpmvEngine> engine = entry->create(csr, kernel_opts);
+        if (!engine) {
+            cerr << "Error: kernel " << entry->name << " cannot be built for this matrix.\n";
+            return 1;
+        }
+        const double setup_ms = (omp_get_wtime() - t0) * 1000.0;
+        const string label  = engine->label();
+        const string detail = engine->describe();
+        cerr << "Kernel " << label << ": setup " << setup_ms << " ms"
+             << (detail.empty() ? "" : ", ") << detail << "\n";
+
+        fill(c_output.begin(), c_output.end(), 0.0);
+        const vector<double> times_ms =
+            bench_measure(bench, [&]() { engine->multiply(v_input, c_output); });
+
+        if (bench.verify) {
+            const double tol = bench.verify_tol > 0.0 ? bench.verify_tol :
+                               engine->reduced_precision() ? VERIFY_TOL_FP32 : VERIFY_TOL_FP64;
+            if (!report_verify(label, verify_spmv(csr, v_input, 1, c_output, tol), tol, 1)) {
+                return 1;
+            }
+        } else if (k == 0) {
+            c_reference     = c_output;
+            reference_label = label;
+        } else {
+            double max_err = 0.0, max_ref = 0.0;
+            for (int i = 0; i < csr.rows; ++i) {
+                max_err = max(max_err, fabs(c_output[i] - c_reference[i]));
+                max_ref = max(max_ref, fabs(c_reference[i]));
+            }
+            cerr << "Kernel " << label << ": max relative error "
+                 << (max_ref > 0.0 ? max_err / max_ref : max_err) << " vs "
+                 << reference_label << "\n";
+        }
+
+        bench_print_result(cout, bench, columns, label + ":" + schedule_str, 2.0 * csr.nnz,
+                           engine->traffic_bytes() + 8.0 * ((double)csr.cols + csr.rows),
+                           times_ms, vector<pair<string, double> >(), ctx.header_printed);
+    }
+    return 0;
+}
+
+// --powers K: x_1 ... x_K (x_p = A x_{p-1}) with the tiled matrix powers
+// kernel (matrix_powers.h), compared with the chain of K runtime-schedule
+// SpMV calls it replaces. The timed call computes all K powers.
+static int run_powers(const CsrMatrix& csr, const vector<double>& v_input, int k, int tile_kb,
+                      const string& filename, const string& schedule_str, int chunk_size,
+                      int num_threads, ThreadBinding binding, const BenchOptions& bench,
+                      BenchmarkContext& ctx) {
+    binding = bind_without_placement(binding, num_threads, "--powers", ctx);
+
+    const double t0 = omp_get_wtime();
+    MatrixPowersPlan plan;
+    build_matrix_powers_plan(csr, k, tile_kb, num_threads, plan);
+    const double setup_ms = (omp_get_wtime() - t0) * 1000.0;
+    if (plan.fallback) {
+        cerr << "Note: the ghost rows of the matrix powers tiles would more than double the "
+                "work;\n      --powers runs the chain of " << k << " SpMV calls instead.\n";
+    } else {
+        cerr << "Matrix powers k=" << k << ": " << plan.tiles.size() << " tiles of "
+             << tile_kb << " KB, ghost rows add " << 100.0 * plan.overhead()
+             << "% flops, setup " << setup_ms << " ms\n";
+    }
+
+    vector<vector<double> > y(k, vector<double>(csr.rows, 0.0));
+    const vector<double> chain_ms =
+        bench_measure(bench, [&]() { matrix_powers_chain(csr, plan, v_input, y); });
+    const vector<double> times_ms =
+        bench_measure(bench, [&]() { spmv_matrix_powers(csr, plan, v_input, y); });
+
+    const string kernel_label = "powers-" + to_string(k);
+    if (bench.verify) {
+        // Every power against A times the previous one
+        const double tol = bench.verify_tol > 0.0 ? bench.verify_tol : VERIFY_TOL_FP64;
+        for (int p = 1; p <= k; ++p) {
+            const VerifyResult result =
+                verify_spmv(csr, p > 1 ? y[p - 2] : v_input, 1, y[p - 1], tol);
+            if (!report_verify(kernel_label + " (power " + to_string(p) + ")", result, tol, 1)) {
+                return 1;
+            }
+        }
+    }
+
+    const double best_ms       = *min_element(times_ms.begin(), times_ms.end());
+    const double best_chain_ms = *min_element(chain_ms.begin(), chain_ms.end());
+    cerr << "Matrix powers k=" << k << ": " << best_ms << " ms vs " << best_chain_ms
+         << " ms for " << k << " SpMV calls (" << schedule_str << "), speedup "
+         << best_chain_ms / best_ms << "\n";
+
+    // Useful flops; the matrix is streamed once and every power written once
+    vector<pair<string, double> > extra;
+    extra.push_back(make_pair("ghost_overhead", plan.overhead()));
+    extra.push_back(make_pair("chain_ms", best_chain_ms));
+    bench_print_result(cout, bench,
+                       result_columns(filename, chunk_size, num_threads, binding, csr.rows,
+                                      csr.cols, csr.nnz),
+                       kernel_label, 2.0 * csr.nnz * k,
+                       csr_traffic_bytes(csr, 8.0) + 8.0 * (double)csr.rows * (k + 1),
+                       times_ms, extra, ctx.header_printed);
+    return 0;
+}
+
+// --offload: the CSR kernel on the OpenMP target device. The matrix is
+// uploaded once; the timed calls run the kernel on vectors kept on the
+// device, and the transfers a call would need (v up, c down) are timed
+// separately, so the kernel times compare with the host lines and the
+// transfers can be added for an end-to-end figure.
+static int run_offload(const CsrMatrix& csr, const vector<double>& v_input,
+                       DeviceKernel device_kernel, const string& filename, int chunk_size,
+                       int num_threads, const BenchOptions& bench, BenchmarkContext& ctx) {
+    const int devices = DeviceCsr::device_count();
+    DeviceCsr device(csr, device_kernel);
+    if (device.on_host()) {
+        cerr << "Note: no offload device (" << devices << " available); the target regions "
+                "run on the host.\n";
+    }
+
+    vector<double> c_output(csr.rows, 0.0);
+    device.map_vectors(v_input.data(), c_output.data());
+    const vector<double> times_ms =
+        bench_measure(bench, [&]() { device.multiply_mapped(v_input.data(), c_output.data()); });
+
+    // Transfers of one call: best of a few
+    double h2d_ms = 0.0, d2h_ms = 0.0;
+    for (int run = 0; run < 5; ++run) {
+        const double t0 = omp_get_wtime();
+        device.update_input(v_input.data());
+        const double t1 = omp_get_wtime();
+        device.update_result(c_output.data());
+        const double t2 = omp_get_wtime();
+        if (run == 0 || (t1 - t0) * 1000.0 < h2d_ms) h2d_ms = (t1 - t0) * 1000.0;
+        if (run == 0 || (t2 - t1) * 1000.0 < d2h_ms) d2h_ms = (t2 - t1) * 1000.0;
+    }
+    device.unmap_vectors(v_input.data(), c_output.data());
+
+    const string kernel_label = string("offload-") + device_kernel_name(device.kernel());
+    cerr << "Offload " << kernel_label << " (mean row " << (double)csr.nnz / max(1, csr.rows)
+         << "): matrix upload " << device.upload_ms() << " ms";
+    if (!device.on_host() && device.upload_ms() > 0.0) {
+        cerr << " (" << device.matrix_bytes() / (device.upload_ms() * 1.0e6) << " GB/s)";
+    }
+    cerr << "; per call v " << h2d_ms << " ms up, c " << d2h_ms << " ms down\n";
+
+    if (bench.verify) {
+        const double tol = bench.verify_tol > 0.0 ? bench.verify_tol : VERIFY_TOL_FP64;
+        if (!report_verify(kernel_label, verify_spmv(csr, v_input, 1, c_output, tol), tol, 1)) {
+            return 1;
+        }
+    }
+
+    // Kernel times only; the transfers are extra columns
+    vector<pair<string, double> > extra;
+    extra.push_back(make_pair("on_device", device.on_host() ? 0.0 : 1.0));
+    extra.push_back(make_pair("upload_ms", device.upload_ms()));
+    extra.push_back(make_pair("h2d_ms", h2d_ms));
+    extra.push_back(make_pair("d2h_ms", d2h_ms));
+    bench_print_result(cout, bench,
+                       result_columns(filename, chunk_size, num_threads, BIND_NONE, csr.rows,
+                                      csr.cols, csr.nnz),
+                       kernel_label, 2.0 * csr.nnz,
+                       device.matrix_bytes() + 8.0 * ((double)csr.cols + csr.rows), times_ms,
+                       extra, ctx.header_printed);
+    return 0;
+}
+
+// --update values|deltas: time stepping on a fixed sparsity pattern
+// (csr_update.h). The structure of the file's triplets is converted once,
+// with the maps from the triplets to the CSR values and from the CSR to the
+// reordered / SELL / BCSR values; a timed call is one step, new triplet
+// values (or deltas) moved through the maps, and is compared with one full
+// rebuild from the triplets.
+static int run_update(const string& filename, bool deltas, const string& format, int sell_c,
+                      int sell_sigma, SellIsa sell_isa, int block_r, int block_c,
+                      const string& reorder, const string& schedule_str, int chunk_size,
+                      int num_threads, ThreadBinding binding, const BenchOptions& bench,
+                      BenchmarkContext& ctx) {
+    binding = bind_without_placement(binding, num_threads, "--update", ctx);
+
+    const double t0 = omp_get_wtime();
+    MtxHeader header;
+    vector<Triplet> triplets;
+    if (!read_matrix_market_triplets(filename, header, triplets)) {
+        return 1;
+    }
+    const double parse_ms = (omp_get_wtime() - t0) * 1000.0;
+    const bool expand = header.symmetry != MTX_GENERAL;
+    const double sign = header.symmetry == MTX_SKEW_SYMMETRIC ? -1.0 : 1.0;
+    const int rows = (int)header.rows;
+    const int cols = (int)header.cols;
+
+    // --- Structure and maps, once ---
+    const double t1 = omp_get_wtime();
+    CsrMatrix csr;
+    CsrValueMap csr_map;
+    coo_to_csr_mapped(triplets, rows, cols, expand, sign, csr, csr_map);
+    const double t2 = omp_get_wtime();
+
+    vector<int> perm;
+    CsrMatrix permuted;
+    DerivedValueMap perm_map;
+    if (reorder != "none") {
+        if (rows != cols) {
+            cerr << "Error: --reorder needs a square matrix.\n";
+            return 1;
+        }
+        if (reorder == "rcm") {
+            rcm_ordering(csr, perm);
+        } else if (!metis_ordering(csr, num_threads, perm)) {
+            return 1;
+        }
+        csr_permute_symmetric(csr, perm, permuted);
+        derived_value_map(csr, [&](const CsrMatrix& tagged, vector<double>& out) {
+            CsrMatrix p;
+            csr_permute_symmetric(tagged, perm, p);
+            out.swap(p.values);
+        }, perm_map);
+    }
+    const CsrMatrix& base = perm.empty() ? csr : permuted;
+
+    SellCSigmaMatrix sell;
+    BcsrMatrix bcsr;
+    DerivedValueMap format_map;
+    string kernel_label = "update-" + format;
+    if (format == "sell") {
+        if (!build_sell_c_sigma(base, sell_c, sell_sigma, sell)) return 1;
+        sell_isa = sell_select_isa(sell_c, sell_isa);
+        if (!derived_value_map(base, [&](const CsrMatrix& tagged, vector<double>& out) {
+                SellCSigmaMatrix s;
+                build_sell_c_sigma(tagged, sell_c, sell_sigma, s);
+                out.swap(s.values);
+            }, format_map)) {
+            cerr << "Error: the SELL build does not keep one slot per entry.\n";
+            return 1;
+        }
+        kernel_label += "-" + to_string(sell_c) + "-" + to_string(sell_sigma);
+    } else if (format == "bcsr") {
+        if (block_r == 0) {
+            const BcsrBlockEstimate best = choose_bcsr_block(base);
+            block_r = best.R;
+            block_c = best.C;
+        }
+        build_bcsr(base, block_r, block_c, bcsr);
+        bcsr_value_map(base, bcsr, format_map);
+        kernel_label += "-" + to_string(block_r) + "x" + to_string(block_c);
+    }
+    kernel_label += ":" + schedule_str;
+    const double setup_ms = (omp_get_wtime() - t2) * 1000.0;
+    cerr << "Update " << (deltas ? "deltas" : "values") << ": pattern and value map "
+         << (t2 - t1) * 1000.0 << " ms after " << parse_ms << " ms parsing, "
+         << (reorder != "none" ? "reordering and " : "") << "format maps " << setup_ms << " ms\n";
+
+    // --- One step: values[k] = triplet k * (1 + 1e-3), or + 1e-3 * triplet k
+    // (generated before the timing) ---
+    vector<double> step_input(triplets.size());
+    for (size_t k = 0; k < triplets.size(); ++k) {
+        step_input[k] = deltas ? 1.0e-3 * triplets[k].val : (1.0 + 1.0e-3) * triplets[k].val;
+    }
+    long long steps = 0;
+    const vector<double> times_ms = bench_measure(bench, [&]() {
+        if (deltas) {
+            csr_add_deltas(csr_map, step_input, csr.values);
+        } else {
+            csr_set_values(csr_map, step_input, csr.values);
+        }
+        if (!perm.empty()) refresh_derived_values(csr, perm_map, permuted.values);
+        if (format == "sell") refresh_derived_values(base, format_map, sell.values);
+        if (format == "bcsr") refresh_derived_values(base, format_map, bcsr.values);
+        ++steps;
+    });
+
+    // --- The rebuild a step replaces, from the triplets of the last step ---
+    for (size_t k = 0; k < triplets.size(); ++k) {
+        triplets[k].val = deltas ? triplets[k].val + steps * step_input[k] : step_input[k];
+    }
+    const double r0 = omp_get_wtime();
+    CsrMatrix rebuilt;
+    coo_to_csr(triplets, rows, cols, rebuilt);
+    if (expand) {
+        CsrMatrix full;
+        csr_expand_symmetric(rebuilt, sign, full);
+        rebuilt = std::move(full);
+    }
+    if (!perm.empty()) {
+        CsrMatrix p;
+        csr_permute_symmetric(rebuilt, perm, p);
+        rebuilt = std::move(p);
+    }
+    SellCSigmaMatrix sell_rebuilt;
+    BcsrMatrix bcsr_rebuilt;
+    if (format == "sell") build_sell_c_sigma(rebuilt, sell_c, sell_sigma, sell_rebuilt);
+    if (format == "bcsr") build_bcsr(rebuilt, block_r, block_c, bcsr_rebuilt);
+    const double rebuild_ms = (omp_get_wtime() - r0) * 1000.0;
+
+    const double best_ms = *min_element(times_ms.begin(), times_ms.end());
+    cerr << kernel_label << ": " << best_ms << " ms per step vs " << rebuild_ms
+         << " ms for a rebuild (+ " << parse_ms << " ms parsing), speedup "
+         << rebuild_ms / best_ms << "\n";
+
+    if (bench.verify) {
+        // SpMV with the refreshed format against the rebuilt matrix
+        vector<double> v_input(cols);
+        fill_random_input(v_input, bench_seed(bench, ctx.seed));
+        vector<double> c_output(rows, 0.0);
+        if (format == "sell") {
+            spmv_sell(sell, sell_isa, v_input, c_output);
+        } else if (format == "bcsr") {
+            spmv_bcsr(bcsr, v_input, c_output);
+        } else {
+            spmv_csr_parallel(base, v_input, c_output);
+        }
+        const double tol = bench.verify_tol > 0.0 ? bench.verify_tol : VERIFY_TOL_FP64;
+        if (!report_verify(kernel_label, verify_spmv(rebuilt, v_input, 1, c_output, tol),
+                           tol, 1)) {
+            return 1;
+        }
+    }
+
+    // Per step: map and input (4 + 8 bytes) and value (8) of every CSR
+    // entry, then per derived format its map, source and target values
+    const int derived = (perm.empty() ? 0 : 1) + (format != "csr" ? 1 : 0);
+    vector<pair<string, double> > extra;
+    extra.push_back(make_pair("rebuild_ms", rebuild_ms));
+    extra.push_back(make_pair("parse_ms", parse_ms));
+    extra.push_back(make_pair("setup_ms", (t2 - t1) * 1000.0 + setup_ms));
+    bench_print_result(cout, bench,
+                       result_columns(filename, chunk_size, num_threads, binding, rows, cols,
+                                      csr.nnz),
+                       kernel_label, 0.0,
+                       (20.0 + 20.0 * derived) * csr.nnz + 8.0 * triplets.size(), times_ms,
+                       extra, ctx.header_printed);
+    return 0;
+}
+
+// Options that change what a run does, for the table of combinations that
+// cannot work together
+enum RunMode {
+    MODE_FORMAT,          // --format other than csr
+    MODE_SPLIT,           // balanced, merge, persistent or steal schedule
+    MODE_HALF,            // --symmetric half
+    MODE_PRECISION,       // --precision other than fp64
+    MODE_NVEC,            // --nvec > 1
+    MODE_SOLVE,
+    MODE_REORDER,
+    MODE_COUNTERS,
+    MODE_THREAD_STATS,
+    MODE_POWERS,
+    MODE_OFFLOAD,
+    MODE_UPDATE,
+    MODE_STREAM,
+    MODE_INDEX,           // 64-bit row offsets or column indices
+    MODE_KERNEL,
+    MODE_TUNE,
+    MODE_BIND,
+    RUN_MODE_COUNT
+};
+
+// A mode and the later modes it cannot be combined with. The solvers,
+// matrix powers, offload, updates, streaming, wide indices and registry
+// engines each run their own kernel, so they exclude the formats, the
+// work splits and each other.
+struct RunModeConflict {
+    RunMode mode;
+    vector<RunMode> excluded;
+    const char* note;     // appended to the error, may be nullptr
+};
+
+static const RunModeConflict run_mode_conflicts[] = {
+    {MODE_FORMAT, {MODE_SPLIT, MODE_HALF, MODE_PRECISION, MODE_NVEC, MODE_SOLVE,
+                   MODE_THREAD_STATS, MODE_POWERS, MODE_OFFLOAD, MODE_STREAM, MODE_INDEX,
+                   MODE_KERNEL, MODE_TUNE}, nullptr},
+    {MODE_SPLIT, {MODE_NVEC, MODE_THREAD_STATS, MODE_POWERS, MODE_OFFLOAD, MODE_UPDATE,
+                  MODE_STREAM, MODE_INDEX}, nullptr},
+    {MODE_SPLIT, {MODE_KERNEL, MODE_TUNE},
+     "the work splits are kernels there: csr-balanced, csr-merge, csr-persistent, csr-steal"},
+    {MODE_HALF, {MODE_PRECISION, MODE_NVEC, MODE_SOLVE, MODE_REORDER, MODE_THREAD_STATS,
+                 MODE_POWERS, MODE_OFFLOAD, MODE_UPDATE, MODE_INDEX, MODE_KERNEL, MODE_TUNE},
+     nullptr},
+    {MODE_PRECISION, {MODE_NVEC, MODE_SOLVE, MODE_POWERS, MODE_OFFLOAD, MODE_UPDATE,
+                      MODE_STREAM, MODE_INDEX, MODE_KERNEL, MODE_TUNE}, nullptr},
+    {MODE_NVEC, {MODE_SOLVE, MODE_THREAD_STATS, MODE_POWERS, MODE_OFFLOAD, MODE_UPDATE,
+                 MODE_STREAM, MODE_INDEX, MODE_KERNEL, MODE_TUNE}, nullptr},
+    {MODE_SOLVE, {MODE_THREAD_STATS, MODE_POWERS, MODE_OFFLOAD, MODE_UPDATE, MODE_STREAM,
+                  MODE_INDEX, MODE_KERNEL, MODE_TUNE}, nullptr},
+    {MODE_REORDER, {MODE_STREAM, MODE_INDEX}, nullptr},
+    {MODE_COUNTERS, {MODE_POWERS, MODE_OFFLOAD, MODE_UPDATE, MODE_STREAM, MODE_INDEX,
+                     MODE_KERNEL, MODE_TUNE}, nullptr},
+    {MODE_THREAD_STATS, {MODE_POWERS, MODE_OFFLOAD, MODE_UPDATE, MODE_STREAM, MODE_INDEX,
+                         MODE_KERNEL, MODE_TUNE}, nullptr},
+    {MODE_POWERS, {MODE_OFFLOAD, MODE_UPDATE, MODE_STREAM, MODE_INDEX, MODE_KERNEL,
+                   MODE_TUNE}, nullptr},
+    {MODE_OFFLOAD, {MODE_UPDATE, MODE_STREAM, MODE_INDEX, MODE_KERNEL, MODE_TUNE, MODE_BIND},
+     nullptr},
+    {MODE_UPDATE, {MODE_STREAM, MODE_INDEX, MODE_KERNEL, MODE_TUNE}, nullptr},
+    {MODE_STREAM, {MODE_INDEX, MODE_KERNEL, MODE_TUNE}, nullptr},
+    {MODE_INDEX, {MODE_KERNEL, MODE_TUNE}, nullptr},
+    {MODE_KERNEL, {MODE_TUNE}, "--tune selects the kernel itself"},
+};
+
+// The modes of a run and how the errors name them ("--format sell")
+struct RunModes {
+    bool on[RUN_MODE_COUNT];
+    string name[RUN_MODE_COUNT];
+
+    RunModes() { fill(on, on + RUN_MODE_COUNT, false); }
+    void set(RunMode mode, bool active, const string& label) {
+        on[mode]   = active;
+        name[mode] = label;
+    }
+};
+
+// False (after an error naming the first pair) if two modes of the run
+// cannot be combined
+static bool check_run_modes(const RunModes& modes) {
+    const size_t count = sizeof(run_mode_conflicts) / sizeof(run_mode_conflicts[0]);
+    for (size_t r = 0; r < count; ++r) {
+        const RunModeConflict& conflict = run_mode_conflicts[r];
+        if (!modes.on[conflict.mode]) continue;
+        for (size_t k = 0; k < conflict.excluded.size(); ++k) {
+            const RunMode other = conflict.excluded[k];
+            if (!modes.on[other]) continue;
+            cerr << "Error: " << modes.name[conflict.mode] << " cannot be combined with "
+                 << modes.name[other];
+            if (conflict.note) cerr << " (" << conflict.note << ")";
+            cerr << ".\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// One benchmark configuration (the command line of a single run).
+static int run_benchmark(int argc, char* argv[], BenchmarkContext& ctx) {
     // Expected CLI:
-    //   ./spmv <matrix.mtx> <schedule_type> <chunk_size> <num_threads>
-    if (argc != 5) {
+    //   ./spmv <matrix.mtx> <schedule_type> <chunk_size> <num_threads> [options]
+    if (argc < 5) {
         cerr << "Usage: " << argv[0]
-             << " <matrix.mtx> <schedule_type> <chunk_size> <num_threads>\n";
-        cerr << "  schedule_type: static, dynamic, guided\n";
+             << " <matrix.mtx> <schedule_type> <chunk_size> <num_threads> [options]\n";
+        cerr << "       " << argv[0]
+             << " <matrix.mtx> --sweep FILE | --sweep-list \"CONFIG; ...\" [options]\n";
+        cerr << "  schedule_type: static, dynamic, guided, balanced, merge, persistent, steal\n";
+        cerr << "                 (balanced: contiguous nnz-balanced row blocks,\n";
+        cerr << "                  merge: merge-path split of rows + nnz,\n";
+        cerr << "                  persistent: balanced blocks on a thread team that\n";
+        cerr << "                  stays alive across calls; chunk_size is ignored;\n";
+        cerr << "                  steal: balanced blocks with work stealing, the owner\n";
+        cerr << "                  takes chunk_size rows at a time)\n";
         cerr << "  chunk_size:    e.g. 10, 100, 1000\n";
         cerr << "  num_threads:   e.g. 1, 2, 4, 8, 16\n";
+        cerr << "Sweep: load the matrix once and run every CONFIG, one per line of FILE\n";
+        cerr << "       or ';'-separated, each \"<schedule_type> <chunk_size> <num_threads>\n";
+        cerr << "       [options]\"; options after FILE apply to every CONFIG\n";
+        cerr << "Options:\n";
+        cerr << "  --symmetric expand|half  storage for symmetric matrices (default: expand)\n";
+        cerr << "                           half keeps the lower triangle and uses the\n";
+        cerr << "                           symmetric kernel (schedule/chunk are ignored)\n";
+        cerr << "  --format csr|csr-delta|sell|bcsr|tiled\n";
+        cerr << "                           storage format of the kernel (default: csr)\n";
+        cerr << "  --sell-c C               SELL chunk height (default: 8)\n";
+        cerr << "  --sell-sigma S           SELL sorting window in rows (default: 256)\n";
+        cerr << "  --sell-isa auto|scalar|avx2|avx512\n";
+        cerr << "                           SELL kernel instruction set (default: auto)\n";
+        cerr << "  --precision fp64|fp32-acc64|fp32\n";
+        cerr << "                           value / accumulation precision of the CSR\n";
+        cerr << "                           kernels (default: fp64)\n";
+        cerr << "  --bind none|compact|scatter|socket\n";
+        cerr << "                           pin the threads (default: none); with a\n";
+        cerr << "                           binding the CSR arrays and vectors are also\n";
+        cerr << "                           first-touched by the threads that use them\n";
+        cerr << "  --nvec k                 multiply by k vectors at once (SpMM, row-major\n";
+        cerr << "                           block; default: 1 = SpMV)\n";
+        cerr << "  --tile-kb auto|N         cache budget of a tiled column panel in KB\n";
+        cerr << "                           (default: auto, tuned by trial runs), or of a\n";
+        cerr << "                           --powers row tile (default: 512)\n";
+        cerr << "  --offload auto|scalar|vector\n";
+        cerr << "                           run the CSR kernel on the OpenMP target device\n";
+        cerr << "                           (matrix kept resident; auto: vector kernel for\n";
+        cerr << "                           mean rows >= 32); kernel times in the CSV,\n";
+        cerr << "                           transfers on stderr\n";
+        cerr << "  --powers K               compute x_1 ... x_K (x_p = A x_{p-1}) with the\n";
+        cerr << "                           cache-tiled matrix powers kernel and compare it\n";
+        cerr << "                           with K calls of the schedule's SpMV (square csr)\n";
+        cerr << "  --update values|deltas   time stepping on a fixed pattern: a timed call\n";
+        cerr << "                           moves new triplet values (or deltas) into the\n";
+        cerr << "                           CSR and the --reorder / --format csr|sell|bcsr\n";
+        cerr << "                           arrays through maps built once, compared with\n";
+        cerr << "                           a rebuild from the triplets (.mtx input)\n";
+        cerr << "  --reorder none|rcm|metis symmetric reordering of square matrices before\n";
+        cerr << "                           the benchmark (default: none)\n";
+        cerr << "  --solve cg|bicgstab      run a Krylov solver on A x = A * ones instead of\n";
+        cerr << "                           the SpMV benchmark (chunk is ignored; the\n";
+        cerr << "                           persistent schedule runs it on the thread team)\n";
+        cerr << "  --tol T                  solver relative residual tolerance (default: 1e-8)\n";
+        cerr << "  --maxit N                solver iteration limit (default: 1000)\n";
+        cerr << "  --history FILE           write the solver residual history as CSV\n";
+        cerr << "  --block auto|RxC         BCSR block size (default: auto, picks the\n";
+        cerr << "                           lowest estimated traffic among 2x2..6x6)\n";
+        cerr << "  --warmup N               untimed calls before timing (default: 1)\n";
+        cerr << "  --runs N                 minimum number of timed calls (default: 10)\n";
+        cerr << "  --min-time MS            time calls until they add up to MS ms\n";
+        cerr << "  --report csv|json        statistics, GFLOP/s, GB/s and build / host\n";
+        cerr << "                           metadata instead of the per-run CSV line\n";
+        cerr << "  --seed N                 seed of the random input vector (default: random)\n";
+        cerr << "  --verify                 check the result against a Kahan-summed sequential\n";
+        cerr << "                           CSR reference after the timed calls\n";
+        cerr << "  --verify-tol T           scaled error tolerance of --verify (default: 1e-10,\n";
+        cerr << "                           1e-4 for the fp32 kernels)\n";
+        cerr << "  --counters               per-thread hardware counters (perf_event) of the\n";
+        cerr << "                           timed calls: cycles, instructions, L1D / LLC\n";
+        cerr << "                           loads and misses, DRAM bytes where available\n";
+        cerr << "  --thread-stats           per-thread rows, nnz, busy and barrier wait time of\n";
+        cerr << "                           the timed calls (rdtsc) and the imbalance factor\n";
+        cerr << "                           max/mean busy time of every call, appended to the\n";
+        cerr << "                           CSV line (static, dynamic or guided csr only)\n";
+        cerr << "  --index auto|32|64|64x64 CSR index width: 32-bit, 64-bit row offsets or\n";
+        cerr << "                           64-bit offsets and columns (default: auto, the\n";
+        cerr << "                           narrowest that fits the matrix)\n";
+        cerr << "  --stream MB              out-of-core SpMV: stream row panels of the binary\n";
+        cerr << "                           CSR cache through MB of buffers, reading the\n";
+        cerr << "                           next panel while the current one is multiplied\n";
+        cerr << "  --kernel NAME[,NAME...]  run registered engines side by side on the same\n";
+        cerr << "                           matrix and vector instead of --format (list:\n";
+        cerr << "                           " << argv[0] << " --kernel list)\n";
+        cerr << "  --tune                   pick the kernel, schedule and thread count (up to\n";
+        cerr << "                           num_threads) from matrix features and trial\n";
+        cerr << "                           runs; the plan is cached next to the matrix\n";
+        cerr << "  --retune                 like --tune, ignoring a cached plan\n";
         return 1;
     }
 
@@ -125,119 +897,900 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Configure OpenMP schedule and number of threads
-    omp_sched_t sched_kind;
-    if (schedule_str == "static") {
+    SymmetricStorage sym_storage = SYM_EXPAND;
+    string format  = "csr";
+    int sell_c     = 8;
+    int sell_sigma = 256;
+    SellIsa sell_isa = SELL_ISA_AUTO;
+    int block_r    = 0;   // 0: pick the BCSR block size automatically
+    int block_c    = 0;
+    Precision precision = PREC_FP64;
+    string precision_str = "fp64";
+    ThreadBinding binding = BIND_NONE;
+    int nvec       = 1;
+    int tile_kb    = 0;   // 0: tune the panel width by trial runs
+    string reorder = "none";
+    string solver  = "none";
+    double solve_tol   = 1e-8;
+    int solve_maxit    = 1000;
+    string history_file;
+    BenchOptions bench;
+    bool count_events = false;
+    bool thread_stats = false;
+    int powers = 0;      // 0: single SpMV
+    bool offload = false;
+    DeviceKernel device_kernel = DEVICE_KERNEL_AUTO;
+    string update_mode = "none";
+    string index_mode = "auto";
+    int stream_mb = 0;   // 0: matrix in memory
+    vector<string> kernel_names;
+    bool tune   = false;
+    bool retune = false;
+    for (int i = 5; i < argc; ++i) {
+        const string opt = argv[i];
+        bool bench_ok = true;
+        if (bench_parse_option(argc, argv, i, bench, bench_ok)) {
+            if (!bench_ok) return 1;
+        } else if (opt == "--symmetric" && i + 1 < argc) {
+            const string mode = argv[++i];
+            if (mode == "expand") {
+                sym_storage = SYM_EXPAND;
+            } else if (mode == "half") {
+                sym_storage = SYM_HALF;
+            } else {
+                cerr << "Error: invalid --symmetric mode. Use: expand, half\n";
+                return 1;
+            }
+        } else if (opt == "--format" && i + 1 < argc) {
+            format = argv[++i];
+            if (format != "csr" && format != "csr-delta" && format != "sell" &&
+                format != "bcsr" && format != "tiled") {
+                cerr << "Error: invalid --format. Use: csr, csr-delta, sell, bcsr, tiled\n";
+                return 1;
+            }
+        } else if (opt == "--sell-c" && i + 1 < argc) {
+            if (!parse_positive(argv[++i], sell_c)) {
+                cerr << "Error: --sell-c must be a positive integer.\n";
+                return 1;
+            }
+        } else if (opt == "--sell-sigma" && i + 1 < argc) {
+            if (!parse_positive(argv[++i], sell_sigma)) {
+                cerr << "Error: --sell-sigma must be a positive integer.\n";
+                return 1;
+            }
+        } else if (opt == "--sell-isa" && i + 1 < argc) {
+            if (!sell_isa_from_name(argv[++i], sell_isa)) {
+                cerr << "Error: invalid --sell-isa. Use: auto, scalar, avx2, avx512\n";
+                return 1;
+            }
+        } else if (opt == "--precision" && i + 1 < argc) {
+            precision_str = argv[++i];
+            if (precision_str == "fp64") {
+                precision = PREC_FP64;
+            } else if (precision_str == "fp32-acc64") {
+                precision = PREC_FP32_ACC64;
+            } else if (precision_str == "fp32") {
+                precision = PREC_FP32;
+            } else {
+                cerr << "Error: invalid --precision. Use: fp64, fp32-acc64, fp32\n";
+                return 1;
+            }
+        } else if (opt == "--bind" && i + 1 < argc) {
+            const string mode = argv[++i];
+            if (mode == "none") {
+                binding = BIND_NONE;
+            } else if (mode == "compact") {
+                binding = BIND_COMPACT;
+            } else if (mode == "scatter") {
+                binding = BIND_SCATTER;
+            } else if (mode == "socket") {
+                binding = BIND_SOCKET;
+            } else {
+                cerr << "Error: invalid --bind. Use: none, compact, scatter, socket\n";
+                return 1;
+            }
+        } else if (opt == "--nvec" && i + 1 < argc) {
+            if (!parse_positive(argv[++i], nvec)) {
+                cerr << "Error: --nvec must be a positive integer.\n";
+                return 1;
+            }
+        } else if (opt == "--tile-kb" && i + 1 < argc) {
+            const string kb = argv[++i];
+            if (kb == "auto") {
+                tile_kb = 0;
+            } else if (!parse_positive(kb, tile_kb)) {
+                cerr << "Error: --tile-kb must be auto or a positive integer.\n";
+                return 1;
+            }
+        } else if (opt == "--reorder" && i + 1 < argc) {
+            reorder = argv[++i];
+            if (reorder != "none" && reorder != "rcm" && reorder != "metis") {
+                cerr << "Error: invalid --reorder. Use: none, rcm, metis\n";
+                return 1;
+            }
+        } else if (opt == "--solve" && i + 1 < argc) {
+            solver = argv[++i];
+            if (solver != "cg" && solver != "bicgstab") {
+                cerr << "Error: invalid --solve. Use: cg, bicgstab\n";
+                return 1;
+            }
+        } else if (opt == "--tol" && i + 1 < argc) {
+            if (!parse_positive(argv[++i], solve_tol)) {
+                cerr << "Error: --tol must be a positive number.\n";
+                return 1;
+            }
+        } else if (opt == "--maxit" && i + 1 < argc) {
+            if (!parse_positive(argv[++i], solve_maxit)) {
+                cerr << "Error: --maxit must be a positive integer.\n";
+                return 1;
+            }
+        } else if (opt == "--history" && i + 1 < argc) {
+            history_file = argv[++i];
+        } else if (opt == "--counters") {
+            count_events = true;
+        } else if (opt == "--thread-stats") {
+            thread_stats = true;
+        } else if (opt == "--offload" && i + 1 < argc) {
+            const string mode = argv[++i];
+            if (mode == "auto") {
+                device_kernel = DEVICE_KERNEL_AUTO;
+            } else if (mode == "scalar") {
+                device_kernel = DEVICE_KERNEL_SCALAR;
+            } else if (mode == "vector") {
+                device_kernel = DEVICE_KERNEL_VECTOR;
+            } else {
+                cerr << "Error: invalid --offload. Use: auto, scalar, vector\n";
+                return 1;
+            }
+            offload = true;
+        } else if (opt == "--update" && i + 1 < argc) {
+            update_mode = argv[++i];
+            if (update_mode != "values" && update_mode != "deltas") {
+                cerr << "Error: invalid --update. Use: values, deltas\n";
+                return 1;
+            }
+        } else if (opt == "--powers" && i + 1 < argc) {
+            if (!parse_positive(argv[++i], powers)) {
+                cerr << "Error: --powers must be a positive integer.\n";
+                return 1;
+            }
+        } else if (opt == "--index" && i + 1 < argc) {
+            index_mode = argv[++i];
+            if (index_mode != "auto" && index_mode != "32" && index_mode != "64" &&
+                index_mode != "64x64") {
+                cerr << "Error: invalid --index. Use: auto, 32, 64, 64x64\n";
+                return 1;
+            }
+        } else if (opt == "--stream" && i + 1 < argc) {
+            if (!parse_positive(argv[++i], stream_mb)) {
+                cerr << "Error: --stream must be a positive number of MB.\n";
+                return 1;
+            }
+        } else if (opt == "--kernel" && i + 1 < argc) {
+            const string list = argv[++i];
+            if (list == "list") {
+                print_kernel_list(cout);
+                return 0;
+            }
+            istringstream names(list);
+            string name;
+            while (getline(names, name, ',')) {
+                if (!find_kernel(name)) {
+                    cerr << "Error: unknown kernel " << name << " (see --kernel list).\n";
+                    return 1;
+                }
+                kernel_names.push_back(name);
+            }
+        } else if (opt == "--tune") {
+            tune = true;
+        } else if (opt == "--retune") {
+            tune = retune = true;
+        } else if (opt == "--block" && i + 1 < argc) {
+            const string block = argv[++i];
+            const size_t x = block.find('x');
+            if (block == "auto") {
+                block_r = block_c = 0;
+            } else if (x == string::npos ||
+                       !parse_positive(block.substr(0, x), block_r) ||
+                       !parse_positive(block.substr(x + 1), block_c)) {
+                cerr << "Error: invalid --block. Use: auto or RxC (e.g. 3x3)\n";
+                return 1;
+            }
+        } else {
+            cerr << "Error: unknown or incomplete option " << opt << "\n";
+            return 1;
+        }
+    }
+
+    // Configure OpenMP schedule and number of threads; the work splits are
+    // computed once per matrix below, with no OpenMP schedule involved
+    omp_sched_t sched_kind = omp_sched_static;
+    CsrSchedule schedule   = CSR_SCHEDULE_RUNTIME;
+    if (schedule_str == "balanced") {
+        schedule = CSR_SCHEDULE_BALANCED;
+    } else if (schedule_str == "merge") {
+        schedule = CSR_SCHEDULE_MERGE;
+    } else if (schedule_str == "persistent") {
+        schedule = CSR_SCHEDULE_PERSISTENT;
+    } else if (schedule_str == "steal") {
+        schedule = CSR_SCHEDULE_STEAL;
+    } else if (schedule_str == "static") {
         sched_kind = omp_sched_static;
     } else if (schedule_str == "dynamic") {
         sched_kind = omp_sched_dynamic;
     } else if (schedule_str == "guided") {
         sched_kind = omp_sched_guided;
     } else {
-        cerr << "Error: invalid scheduling type. Use: static, dynamic, guided\n";
+        cerr << "Error: invalid scheduling type. "
+                "Use: static, dynamic, guided, balanced, merge, persistent, steal\n";
+        return 1;
+    }
+
+    RunModes modes;
+    modes.set(MODE_FORMAT, format != "csr", "--format " + format);
+    modes.set(MODE_SPLIT, schedule != CSR_SCHEDULE_RUNTIME, "the " + schedule_str + " schedule");
+    modes.set(MODE_HALF, sym_storage == SYM_HALF, "--symmetric half");
+    modes.set(MODE_PRECISION, precision != PREC_FP64, "--precision " + precision_str);
+    modes.set(MODE_NVEC, nvec > 1, "--nvec " + to_string(nvec));
+    modes.set(MODE_SOLVE, solver != "none", "--solve " + solver);
+    modes.set(MODE_REORDER, reorder != "none", "--reorder " + reorder);
+    modes.set(MODE_COUNTERS, count_events, "--counters");
+    modes.set(MODE_THREAD_STATS, thread_stats, "--thread-stats");
+    modes.set(MODE_POWERS, powers > 0, "--powers");
+    modes.set(MODE_OFFLOAD, offload, "--offload");
+    modes.set(MODE_UPDATE, update_mode != "none", "--update " + update_mode);
+    modes.set(MODE_STREAM, stream_mb > 0, "--stream");
+    modes.set(MODE_INDEX, index_mode == "64" || index_mode == "64x64", "--index " + index_mode);
+    modes.set(MODE_KERNEL, !kernel_names.empty(), "--kernel");
+    modes.set(MODE_TUNE, tune, retune ? "--retune" : "--tune");
+    modes.set(MODE_BIND, binding != BIND_NONE, string("--bind ") + thread_binding_name(binding));
+    if (!check_run_modes(modes)) {
+        return 1;
+    }
+    if (update_mode != "none" && format != "csr" && format != "sell" && format != "bcsr") {
+        cerr << "Error: --update supports --format csr, sell or bcsr only.\n";
         return 1;
     }
 
     omp_set_num_threads(num_threads);
     omp_set_schedule(sched_kind, chunk_size);
+    if (ctx.bound_threads > 0) {
+        unbind_threads(ctx.bound_threads);
+        ctx.bound_threads = 0;
+    }
 
-    // --- Read Matrix Market file (.mtx) ---
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Error: could not open file " << filename << "\n";
+    // --- Out-of-core mode: the matrix is never loaded as a whole ---
+    if (stream_mb > 0) {
+        return run_stream(filename, "stream:" + schedule_str, chunk_size, num_threads, binding,
+                          stream_mb, bench, ctx);
+    }
+
+    // --- Index width: from the file header unless forced by --index ---
+    const bool context_matches = ctx.loaded && ctx.filename == filename &&
+                                 ctx.storage == sym_storage;
+    CsrIndexWidth index_width = CSR_INDEX_32;
+    if (index_mode == "64") {
+        index_width = CSR_OFFSET_64;
+    } else if (index_mode == "64x64") {
+        index_width = CSR_INDEX_64;
+    } else if (index_mode == "auto" && !context_matches &&
+               !matrix_index_width(filename, sym_storage, index_width)) {
         return 1;
     }
+    if (index_width != CSR_INDEX_32) {
+        // Only the runtime-schedule CSR kernel is templated on the index types
+        if (index_mode == "auto") {
+            modes.set(MODE_INDEX, true, string("the index width ") +
+                                        csr_index_width_name(index_width) + " the matrix needs");
+        }
+        if (!check_run_modes(modes)) {
+            return 1;
+        }
+        const string label = string("idx") + csr_index_width_name(index_width) + ":" +
+                             schedule_str;
+        if (index_width == CSR_OFFSET_64) {
+            return run_wide_benchmark<long long, int>(filename, label, chunk_size,
+                                                      num_threads, binding, bench, ctx);
+        }
+        return run_wide_benchmark<long long, long long>(filename, label, chunk_size,
+                                                        num_threads, binding, bench, ctx);
+    }
 
-    vector<Triplet> triplets;
-    int rows, cols, nnz;
-    string line;
+    // --- Value updates: built from the file's triplets, not from the cache ---
+    if (update_mode != "none") {
+        return run_update(filename, update_mode == "deltas", format, sell_c, sell_sigma,
+                          sell_isa, block_r, block_c, reorder, schedule_str, chunk_size,
+                          num_threads, binding, bench, ctx);
+    }
 
-    // Skip comments starting with '%'
-    while (getline(file, line)) {
-        if (line.empty()) continue;
-        if (line[0] != '%') break;
+    // --- Load matrix (binary CSR cache, or parse .mtx and convert COO -> CSR) ---
+    // A sweep loads it once; every configuration then works on a copy, since
+    // reordering and first-touch placement modify the matrix.
+    if (!context_matches) {
+        ctx.loaded = false;
+        if (!load_matrix(filename, ctx.csr, sym_storage)) {
+            return 1;
+        }
+        ctx.loaded   = true;
+        ctx.filename = filename;
+        ctx.storage  = sym_storage;
+    }
+    CsrMatrix csr;
+    if (ctx.reuse) {
+        csr = ctx.csr;
+    } else {
+        csr = std::move(ctx.csr);
+        ctx.loaded = false;
     }
+    const int rows = csr.rows;
+    const int cols = csr.cols;
 
-    stringstream ss(line);
-    ss >> rows >> cols >> nnz;
-    triplets.reserve(nnz);
+    // --- Optional reordering: csr becomes P A P^T, the vectors follow perm ---
+    vector<int> perm;
+    CsrMatrix csr_original;   // kept for the break-even estimate
+    double reorder_ms = 0.0;
+    if (reorder != "none") {
+        if (rows != cols) {
+            cerr << "Error: --reorder needs a square matrix.\n";
+            return 1;
+        }
+        long long bw_before = 0, profile_before = 0, bw_after = 0, profile_after = 0;
+        csr_bandwidth_profile(csr, bw_before, profile_before);
 
-    int r, c;
-    double v;
-    for (int i = 0; i < nnz; ++i) {
-        if (!(file >> r >> c >> v)) {
-            cerr << "Error reading matrix data.\n";
+        const double t0 = omp_get_wtime();
+        if (reorder == "rcm") {
+            rcm_ordering(csr, perm);
+        } else if (!metis_ordering(csr, num_threads, perm)) {
             return 1;
         }
-        // Convert from 1-based (MatrixMarket) to 0-based indices
-        Triplet t;
-        t.row = r - 1;
-        t.col = c - 1;
-        t.val = v;
-        triplets.push_back(t);
+        const double t1 = omp_get_wtime();
+        CsrMatrix permuted;
+        csr_permute_symmetric(csr, perm, permuted);
+        const double t2 = omp_get_wtime();
+        reorder_ms = (t2 - t0) * 1000.0;
+
+        csr_original.row_ptr.swap(csr.row_ptr);
+        csr_original.col_ind.swap(csr.col_ind);
+        csr_original.values.swap(csr.values);
+        csr_original.rows = csr.rows;
+        csr_original.cols = csr.cols;
+        csr_original.nnz  = csr.nnz;
+        csr = permuted;
+
+        csr_bandwidth_profile(csr, bw_after, profile_after);
+        cerr << "Reorder " << reorder << ": bandwidth " << bw_before << " -> " << bw_after
+             << ", profile " << profile_before << " -> " << profile_after
+             << "; ordering " << (t1 - t0) * 1000.0 << " ms + permutation "
+             << (t2 - t1) * 1000.0 << " ms\n";
     }
-    file.close();
 
-    // --- Convert COO -> CSR ---
-    sort(triplets.begin(), triplets.end(), compareTriplets);
+    // --- Device kernel instead of the host pipeline below ---
+    if (offload) {
+        vector<double> v_input(cols);
+        fill_random_input(v_input, bench_seed(bench, ctx.seed));
+        if (!perm.empty()) {
+            permute_rows(v_input, perm, 1, false);
+        }
+        return run_offload(csr, v_input, device_kernel, filename, chunk_size, num_threads,
+                           bench, ctx);
+    }
 
-    CsrMatrix csr;
-    csr.rows = rows;
-    csr.cols = cols;
-    csr.nnz  = nnz;
-    csr.row_ptr.assign(rows + 1, 0);
-    csr.col_ind.resize(nnz);
-    csr.values.resize(nnz);
+    // --- Matrix powers instead of the single SpMV below ---
+    if (powers > 0) {
+        if (rows != cols) {
+            cerr << "Error: --powers needs a square matrix.\n";
+            return 1;
+        }
+        vector<double> v_input(cols);
+        fill_random_input(v_input, bench_seed(bench, ctx.seed));
+        if (!perm.empty()) {
+            permute_rows(v_input, perm, 1, false);
+        }
+        return run_powers(csr, v_input, powers, tile_kb > 0 ? tile_kb : MATRIX_POWERS_TILE_KB,
+                          filename, schedule_str, chunk_size, num_threads, binding, bench, ctx);
+    }
 
-    int current_row = 0;
-    for (int i = 0; i < nnz; ++i) {
-        csr.col_ind[i] = triplets[i].col;
-        csr.values[i]  = triplets[i].val;
+    // Parameters of the registered engines: --kernel, --tune and the
+    // --format pipeline below
+    KernelOptions kernel_opts;
+    kernel_opts.threads    = num_threads;
+    kernel_opts.chunk      = chunk_size;
+    kernel_opts.sell_c     = sell_c;
+    kernel_opts.sell_sigma = sell_sigma;
+    kernel_opts.sell_isa   = sell_isa;
+    kernel_opts.block_r    = block_r;
+    kernel_opts.block_c    = block_c;
+    kernel_opts.tile_kb    = tile_kb;
 
-        while (current_row < triplets[i].row) {
-            ++current_row;
-            csr.row_ptr[current_row] = i;
+    // --- Registered engines instead of the --format pipeline below ---
+    if (!kernel_names.empty() || tune) {
+        vector<double> v_input(cols);
+        fill_random_input(v_input, bench_seed(bench, ctx.seed));
+        if (!perm.empty()) {
+            permute_rows(v_input, perm, 1, false);
         }
+        if (tune) {
+            TunedPlan plan;
+            if (!select_tuned_plan(filename, csr, reorder, chunk_size, num_threads, retune,
+                                   kernel_opts, v_input, plan)) {
+                return 1;
+            }
+            kernel_names.assign(1, plan.kernel);
+            kernel_opts  = plan.options;
+            schedule_str = plan.schedule;
+            chunk_size   = plan.chunk;
+            num_threads  = plan.threads;
+            tune_set_schedule(schedule_str, chunk_size, num_threads);
+        }
+        return run_kernels(csr, v_input, kernel_names, kernel_opts, filename, schedule_str,
+                           chunk_size, num_threads, binding, bench, ctx);
+    }
+
+    // Derived formats and work splits are built once per matrix and reused
+    // by every call. A --format other than csr is the registry engine of
+    // that name, run with the OpenMP schedule.
+    SymmetricSpmvPlan sym_plan;
+    CsrSplitPlan split;
+    unique_ptr<SpmvEngine> format_engine;
+    string kernel_label = schedule_str;
+    if (format != "csr") {
+        if (format == "tiled" && tile_kb == 0) cerr << "Tuning column tiles:\n";
+        const double t0 = omp_get_wtime();
+        format_engine = find_kernel(format)->create(csr, kernel_opts);
+        if (!format_engine) {
+            return 1;
+        }
+        const double setup_ms = (omp_get_wtime() - t0) * 1000.0;
+        const string detail   = format_engine->describe();
+        kernel_label = format_engine->label() + ":" + schedule_str;
+        cerr << "Format " << format_engine->label() << ": setup " << setup_ms << " ms"
+             << (detail.empty() ? "" : ", ") << detail << "\n";
+
+        // The tiles trade extra traffic for reuse of v; the other formats
+        // only pay off if they stream less than CSR
+        const double csr_bytes = csr_traffic_bytes(csr, 8.0);
+        if (format != "tiled" && format_engine->traffic_bytes() >= csr_bytes) {
+            cerr << "Warning: " << format_engine->label() << " streams "
+                 << format_engine->traffic_bytes() / max(1, csr.nnz) << " B/nnz on this "
+                    "matrix, no less than CSR (" << csr_bytes / max(1, csr.nnz) << ").\n";
+        }
+    } else if (precision != PREC_FP64) {
+        kernel_label = precision_str + ":" + schedule_str;
+    } else if (nvec > 1) {
+        kernel_label = "spmm-" + to_string(nvec) + ":" + schedule_str;
     }
-    for (int i = current_row + 1; i <= rows; ++i) {
-        csr.row_ptr[i] = nnz;
+    if (csr.symmetric) {
+        build_symmetric_plan(csr, num_threads, sym_plan);
+    } else {
+        build_csr_split(csr, schedule, num_threads, chunk_size, split);
+    }
+    ThreadTeam* team = split.team.get();
+
+    // Single-precision copies for the mixed-precision modes
+    BasicCsrMatrix<float> csr32;
+    if (precision != PREC_FP64) {
+        csr_convert_values(csr, csr32);
     }
 
     // --- Generate random input vector v in [-1000, 1000] ---
-    vector<double> v_input(cols);
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<double> dist(-1000.0, 1000.0);
-    for (int i = 0; i < cols; ++i) {
-        v_input[i] = dist(gen);
+    // (with --nvec k: a row-major cols x k block of k input vectors)
+    vector<double> v_input((size_t)cols * nvec);
+    fill_random_input(v_input, bench_seed(bench, ctx.seed));
+
+    vector<double> c_output((size_t)rows * nvec, 0.0);
+
+    if (!perm.empty()) {
+        permute_rows(v_input, perm, nvec, false);
+    }
+
+    vector<float> v_input32, c_output32;
+    if (precision == PREC_FP32) {
+        v_input32.assign(v_input.begin(), v_input.end());
+        c_output32.assign(rows, 0.0f);
+    }
+
+    // --- Thread binding and first-touch placement ---
+    // Done after all conversions, which run on every core (io_num_threads)
+    if (binding != BIND_NONE) {
+        vector<vector<int> > cpu_sets;
+        if (!bind_threads(binding, num_threads, cpu_sets)) {
+            cerr << "Warning: thread binding is not supported here; running unbound.\n";
+            binding = BIND_NONE;
+        } else {
+            ctx.bound_threads = num_threads;
+            cerr << "Binding " << thread_binding_name(binding) << ":";
+            for (int t = 0; t < num_threads; ++t) {
+                const vector<int>& set = cpu_sets[t];
+                cerr << (t == 0 ? " cpus " : ",") << set.front();
+                if (set.size() > 1) cerr << "-" << set.back();
+            }
+            cerr << "\n";
+
+            // Team thread t gets the CPU set of OpenMP thread t, so the
+            // first-touch below lands on the same nodes
+            if (team) {
+                team->run([&](int tid) { bind_current_thread(cpu_sets[tid]); });
+            }
+
+            // Same row -> thread mapping as the kernel that will run
+            const RowPartition* owner = split.row_owners();
+            if (format_engine || csr.symmetric || nvec > 1) {
+                cerr << "Note: first-touch placement is applied to the CSR SpMV kernels only.\n";
+            } else if (precision == PREC_FP32) {
+                numa_first_touch(csr32, owner, num_threads, v_input32, c_output32);
+            } else if (precision == PREC_FP32_ACC64) {
+                numa_first_touch(csr32, owner, num_threads, v_input, c_output);
+            } else {
+                numa_first_touch(csr, owner, num_threads, v_input, c_output);
+            }
+        }
+    }
+
+    // --- Solver mode: A x = b with b = A * ones, instead of the SpMV runs ---
+    if (solver != "none") {
+        if (rows != cols) {
+            cerr << "Error: --solve needs a square matrix.\n";
+            return 1;
+        }
+        RowPartition solve_partition;
+        partition_rows_by_nnz(csr, num_threads, solve_partition);
+
+        vector<double> ones(cols, 1.0), b(rows), x;
+        spmv_csr_parallel(csr, ones, b);
+
+        KrylovResult result;
+        const double start = omp_get_wtime();
+        if (team && solver == "cg") {
+            cg_solve(*team, csr, solve_partition, b, x, solve_tol, solve_maxit, result);
+        } else if (team) {
+            bicgstab_solve(*team, csr, solve_partition, b, x, solve_tol, solve_maxit, result);
+        } else if (solver == "cg") {
+            cg_solve(csr, solve_partition, b, x, solve_tol, solve_maxit, result);
+        } else {
+            bicgstab_solve(csr, solve_partition, b, x, solve_tol, solve_maxit, result);
+        }
+        const double total_ms = (omp_get_wtime() - start) * 1000.0;
+        const double per_iteration_ms = total_ms / max(1, result.iterations);
+
+        // A NaN entry must not vanish in max(): it makes the error NaN
+        double max_err = 0.0;
+        for (int i = 0; i < rows; ++i) {
+            const double e = fabs(x[i] - 1.0);
+            if (!std::isfinite(e) || e > max_err) max_err = e;
+            if (!std::isfinite(e)) break;
+        }
+        cerr << solver << ": "
+             << (result.converged ? "converged"
+                                  : result.breakdown ? "breakdown" : "not converged")
+             << " after " << result.iterations << " iterations, relative residual "
+             << result.residual << ", max |x - 1| " << max_err << ", "
+             << per_iteration_ms << " ms per iteration\n";
+
+        if (!history_file.empty()) {
+            ofstream history(history_file.c_str());
+            if (!history) {
+                cerr << "Error: cannot write " << history_file << "\n";
+                return 1;
+            }
+            history << "iteration,relative_residual\n";
+            for (size_t k = 0; k < result.history.size(); ++k) {
+                history << k << "," << result.history[k] << "\n";
+            }
+        }
+
+        // matrix,solver,threads,bind,iterations,converged,residual,total_ms,ms_per_iteration
+        cout << extract_matrix_name(filename) << "," << solver << "," << num_threads << ","
+             << thread_binding_name(binding) << "," << result.iterations << ","
+             << (result.converged ? 1 : 0) << "," << result.residual << ","
+             << total_ms << "," << per_iteration_ms << "\n";
+        if (!std::isfinite(max_err) || !std::isfinite(result.residual)) {
+            cerr << "Error: " << solver << " produced a non-finite "
+                 << (std::isfinite(result.residual) ? "solution" : "residual")
+                 << (solver == "cg" ? " (is the matrix SPD?)" : "") << ".\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    // --- Hardware counters: opened by every thread that runs the kernel,
+    // enabled for the timed calls only ---
+    unique_ptr<PerfCounters> counters;
+    if (count_events) {
+        counters.reset(new PerfCounters(num_threads));
+        PerfCounters& pc = *counters;
+        if (team) {
+            team->run([&](int tid) { pc.open_current_thread(tid); });
+        } else {
+            #pragma omp parallel num_threads(num_threads)
+            pc.open_current_thread(omp_get_thread_num());
+        }
+        pc.open_dram();
+        if (!pc.any_available()) {
+            cerr << "Warning: no performance counters could be opened "
+                    "(check perf_event_paranoid); --counters ignored.\n";
+            counters.reset();
+        }
     }
 
-    vector<double> c_output(rows, 0.0);
+    // --- Per-thread timing: the runtime-schedule kernel with rdtsc stamps,
+    // recorded for the timed calls only ---
+    unique_ptr<ThreadStats> stats;
+    if (thread_stats) stats.reset(new ThreadStats(num_threads));
 
-    // --- Warm-up run (not timed, just to stabilize caches / OpenMP runtime) ---
-    spmv_csr_parallel(csr, v_input, c_output);
+    auto run_spmv = [&]() {
+        if (stats && precision == PREC_FP32_ACC64) {
+            spmv_csr_parallel_timed(csr32, v_input, c_output, *stats);
+        } else if (stats && precision == PREC_FP32) {
+            spmv_csr_parallel_timed(csr32, v_input32, c_output32, *stats);
+        } else if (stats) {
+            spmv_csr_parallel_timed(csr, v_input, c_output, *stats);
+        } else if (nvec > 1) {
+            spmm_csr(csr, nvec, v_input, c_output);
+        } else if (format_engine) {
+            format_engine->multiply(v_input, c_output);
+        } else if (csr.symmetric) {
+            spmv_csr_symmetric(csr, sym_plan, v_input, c_output);
+        } else if (precision == PREC_FP32_ACC64) {
+            spmv_csr_split(csr32, split, v_input, c_output);
+        } else if (precision == PREC_FP32) {
+            spmv_csr_split(csr32, split, v_input32, c_output32);
+        } else {
+            spmv_csr_split(csr, split, v_input, c_output);
+        }
+    };
 
-    // --- Timed runs ---
-    const int NUM_RUNS = 10;
-    vector<double> times_ms(NUM_RUNS);
+    // --- Warm-up calls (not timed, just to stabilize caches / OpenMP runtime),
+    // then the timed runs ---
+    const vector<double> times_ms = bench_measure(bench, run_spmv,
+        [&]() {
+            if (counters) counters->enable();
+            if (stats) stats->enable();
+        },
+        [&]() {
+            if (counters) counters->disable();
+            if (stats) stats->disable();
+        });
+    const int num_runs = static_cast<int>(times_ms.size());
 
-    for (int run = 0; run < NUM_RUNS; ++run) {
-        double start = omp_get_wtime();
-        spmv_csr_parallel(csr, v_input, c_output);
-        double end   = omp_get_wtime();
-        times_ms[run] = (end - start) * 1000.0; // milliseconds
+    // Check the result of the last timed call (in the reordered numbering,
+    // before anything below overwrites c_output)
+    if (bench.verify) {
+        const double tol = bench.verify_tol > 0.0 ? bench.verify_tol :
+                           precision != PREC_FP64 ? VERIFY_TOL_FP32 : VERIFY_TOL_FP64;
+        CsrMatrix expanded;
+        if (csr.symmetric) csr_expand_symmetric(csr, 1.0, expanded);
+        const CsrMatrix& reference = csr.symmetric ? expanded : csr;
+        const VerifyResult result = precision == PREC_FP32 ?
+            verify_spmv(reference, v_input, nvec, c_output32, tol) :
+            verify_spmv(reference, v_input, nvec, c_output, tol);
+        if (!report_verify(kernel_label, result, tol, nvec)) {
+            return 1;
+        }
     }
 
-    string matrix_name = extract_matrix_name(filename);
+    // Counters per timed call, per thread and in total
+    vector<pair<string, double> > counter_fields;
+    if (counters) {
+        const PerfCounters& pc = *counters;
+        cerr << "Counters per SpMV (" << num_runs << " timed calls):\n  thread";
+        for (int e = 0; e < PERF_EV_COUNT; ++e) {
+            if (pc.available(e)) cerr << " " << perf_event_label(e);
+        }
+        cerr << "\n";
+        for (int t = 0; t <= num_threads; ++t) {
+            if (t < num_threads) cerr << "  " << t; else cerr << "  total";
+            for (int e = 0; e < PERF_EV_COUNT; ++e) {
+                if (!pc.available(e)) continue;
+                const double v = (t < num_threads ? pc.value(t, e) : pc.total(e)) / num_runs;
+                cerr << " " << v;
+                if (t == num_threads) counter_fields.push_back(make_pair(perf_event_label(e), v));
+            }
+            cerr << "\n";
+        }
+        if (pc.available(PERF_EV_CYCLES) && pc.available(PERF_EV_INSTRUCTIONS)) {
+            const double cycles = pc.total(PERF_EV_CYCLES);
+            const double ipc = cycles > 0.0 ? pc.total(PERF_EV_INSTRUCTIONS) / cycles : 0.0;
+            cerr << "  IPC " << ipc << "\n";
+            counter_fields.push_back(make_pair("ipc", ipc));
+        }
+        if (pc.dram_available()) {
+            double total_ms = 0.0;
+            for (int run = 0; run < num_runs; ++run) total_ms += times_ms[run];
+            const double bytes = pc.dram_bytes() / num_runs;
+            cerr << "  DRAM " << bytes << " bytes per SpMV ("
+                 << pc.dram_bytes() / (total_ms * 1.0e6) << " GB/s)\n";
+            counter_fields.push_back(make_pair("dram_bytes", bytes));
+        } else {
+            cerr << "  DRAM bytes: not available (no accessible uncore_imc counters)\n";
+        }
+    }
 
-    cout << matrix_name << "," << schedule_str << ","
-         << chunk_size << "," << num_threads;
+    // Per-thread work and time per timed call; the imbalance factors of the
+    // single calls go to the CSV line, their mean and maximum to the report
+    if (stats) {
+        double busy_sum = 0.0, wait_sum = 0.0;
+        cerr << "Thread stats per SpMV (" << stats->calls() << " timed calls):\n"
+                "  thread rows nnz busy_ms wait_ms\n";
+        for (int t = 0; t < num_threads; ++t) {
+            cerr << "  " << t << " " << stats->rows(t) << " " << stats->nnz(t) << " "
+                 << stats->busy_ms(t) << " " << stats->wait_ms(t) << "\n";
+            busy_sum += stats->busy_ms(t);
+            wait_sum += stats->wait_ms(t);
+        }
+        const vector<double>& imbalance = stats->imbalance();
+        double imbalance_mean = 0.0;
+        for (size_t k = 0; k < imbalance.size(); ++k) imbalance_mean += imbalance[k];
+        imbalance_mean /= max<size_t>(1, imbalance.size());
+        const double imbalance_max = imbalance.empty() ? 1.0 :
+                                     *max_element(imbalance.begin(), imbalance.end());
+        const double wait_share = busy_sum + wait_sum > 0.0 ? wait_sum / (busy_sum + wait_sum)
+                                                            : 0.0;
+        cerr << "  imbalance max/mean busy: mean " << imbalance_mean << ", worst "
+             << imbalance_max << "; " << 100.0 * wait_share
+             << "% of thread time waiting at the barrier\n";
+        counter_fields.push_back(make_pair("imbalance", imbalance_mean));
+        counter_fields.push_back(make_pair("imbalance_max", imbalance_max));
+        counter_fields.push_back(make_pair("wait_share", wait_share));
+    }
 
-    for (int run = 0; run < NUM_RUNS; ++run) {
-        cout << "," << times_ms[run];
+    // Work stealing: steals per call (warm-up included)
+    if (split.schedule == CSR_SCHEDULE_STEAL) {
+        cerr << "Work stealing: "
+             << (double)split.steal.take_steals() / (num_runs + bench.warmup)
+             << " steals per SpMV\n";
     }
-    cout << "\n";
 
+    // SpMM: effective rate over all k vectors and time per vector (best run)
+    if (nvec > 1) {
+        const double best_ms = *min_element(times_ms.begin(), times_ms.end());
+        cerr << "SpMM k=" << nvec << ": " << best_ms / nvec << " ms per vector, "
+             << 2.0 * csr.nnz * nvec / (best_ms * 1.0e6) << " GFLOP/s effective\n";
+    }
+
+    // Accuracy of the reduced-precision result against the fp64 kernel:
+    // max_i |c_i - c64_i| / max_i |c64_i|
+    if (precision != PREC_FP64) {
+        if (precision == PREC_FP32) {
+            c_output.assign(c_output32.begin(), c_output32.end());
+        }
+        vector<double> c_ref(rows, 0.0);
+        spmv_csr_parallel(csr, v_input, c_ref);
+
+        double max_err = 0.0, max_ref = 0.0;
+        for (int i = 0; i < rows; ++i) {
+            max_err = max(max_err, fabs(c_output[i] - c_ref[i]));
+            max_ref = max(max_ref, fabs(c_ref[i]));
+        }
+        cerr << "Precision " << precision_str << ": max relative error "
+             << (max_ref > 0.0 ? max_err / max_ref : max_err) << " vs fp64\n";
+    }
+
+    // Reordering: un-permute the result and estimate after how many calls
+    // the reorder pays off against the same CSR kernel on the original order
+    if (!perm.empty()) {
+        const double t0 = omp_get_wtime();
+        permute_rows(c_output, perm, nvec, true);
+        permute_rows(v_input, perm, nvec, true);
+        const double unpermute_ms = (omp_get_wtime() - t0) * 1000.0;
+        cerr << "Reorder " << reorder << ": " << reorder_ms << " ms, vector un-permute "
+             << unpermute_ms << " ms\n";
+
+        if (format == "csr" && precision == PREC_FP64 && nvec == 1) {
+            // Same schedule, on the (bound) team of the timed calls
+            CsrSplitPlan original;
+            original.team = std::move(split.team);
+            build_csr_split(csr_original, schedule, num_threads, chunk_size, original);
+
+            double original_ms = 0.0;
+            for (int run = 0; run <= 3; ++run) {
+                const double start = omp_get_wtime();
+                spmv_csr_split(csr_original, original, v_input, c_output);
+                const double ms = (omp_get_wtime() - start) * 1000.0;
+                if (run == 1 || (run > 1 && ms < original_ms)) original_ms = ms;
+            }
+            const double reordered_ms = *min_element(times_ms.begin(), times_ms.end());
+            cerr << "Reorder break-even: original " << original_ms << " ms, reordered "
+                 << reordered_ms << " ms per SpMV -> ";
+            if (reordered_ms < original_ms) {
+                cerr << reorder_ms / (original_ms - reordered_ms) << " SpMV calls\n";
+            } else {
+                cerr << "never (no speedup)\n";
+            }
+        }
+    }
+
+    // Nonzeros of the full matrix (half storage keeps one triangle)
+    long long full_nnz = csr.nnz;
+    if (csr.symmetric) {
+        long long diagonal = 0;
+        for (int i = 0; i < rows; ++i) {
+            for (int j = csr.row_ptr[i]; j < csr.row_ptr[i + 1]; ++j) {
+                if (csr.col_ind[j] == i) ++diagonal;
+            }
+        }
+        full_nnz = 2 * (long long)csr.nnz - diagonal;
+    }
+
+    // Bytes streamed per call by the selected format
+    const double value_bytes  = (precision == PREC_FP64) ? 8.0 : 4.0;
+    const double vector_bytes = (precision == PREC_FP32) ? 4.0 : 8.0;
+    const double matrix_bytes = format_engine ? format_engine->traffic_bytes()
+                                              : csr_traffic_bytes(csr, value_bytes);
+    const double vector_traffic = vector_bytes * nvec * ((double)cols + rows);
+
+    // The legacy line carries the imbalance factor of every timed call
+    bench_print_result(cout, bench,
+                       result_columns(filename, chunk_size, num_threads, binding, rows, cols,
+                                      full_nnz),
+                       kernel_label, 2.0 * full_nnz * nvec, matrix_bytes + vector_traffic,
+                       times_ms, counter_fields, ctx.header_printed,
+                       stats ? stats->imbalance() : vector<double>());
     return 0;
 }
 
+// Sweep: ./spmv <matrix.mtx> --sweep FILE [options] or --sweep-list "..."
+// Every configuration is run through run_benchmark with the options given
+// after FILE inserted before its own, so an entry can override them.
+static int run_sweep(int argc, char* argv[]) {
+    const string mode = argv[2];
+    vector<string> configs;
+    if (mode == "--sweep") {
+        ifstream in(argv[3]);
+        if (!in) {
+            cerr << "Error: cannot read sweep file " << argv[3] << "\n";
+            return 1;
+        }
+        string line;
+        while (getline(in, line)) configs.push_back(line);
+    } else {
+        istringstream list(argv[3]);
+        string item;
+        while (getline(list, item, ';')) configs.push_back(item);
+    }
+
+    BenchmarkContext ctx;
+    ctx.reuse = true;
+    int done = 0, failed = 0;
+    for (size_t k = 0; k < configs.size(); ++k) {
+        // '#' starts a comment; blank entries are skipped
+        istringstream tokens(configs[k].substr(0, configs[k].find('#')));
+        vector<string> args;
+        args.push_back(argv[0]);
+        args.push_back(argv[1]);
+        string token;
+        while (tokens >> token) args.push_back(token);
+        if (args.size() == 2) continue;
+        if (args.size() < 5) {
+            cerr << "Error: sweep entry " << k + 1
+                 << ": expected <schedule_type> <chunk_size> <num_threads> [options]\n";
+            ++failed;
+            continue;
+        }
+        args.insert(args.begin() + 5, argv + 4, argv + argc);
+
+        vector<char*> entry_argv;
+        for (size_t a = 0; a < args.size(); ++a) entry_argv.push_back(&args[a][0]);
+        entry_argv.push_back(nullptr);
+        if (run_benchmark(static_cast<int>(args.size()), entry_argv.data(), ctx) != 0) {
+            cerr << "Error: sweep entry " << k + 1 << " failed\n";
+            ++failed;
+        } else {
+            ++done;
+        }
+        cout.flush();
+    }
+    cerr << "Sweep: " << done << " configurations done, " << failed << " failed\n";
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 3 && string(argv[1]) == "--kernel" && string(argv[2]) == "list") {
+        print_kernel_list(cout);
+        return 0;
+    }
+    if (argc >= 4 && (string(argv[2]) == "--sweep" || string(argv[2]) == "--sweep-list")) {
+        return run_sweep(argc, argv);
+    }
+    BenchmarkContext ctx;
+    return run_benchmark(argc, argv, ctx);
+}
@@ -1,175 +1,114 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <chrono>
 #include <random>
 
+#include "matrix_io.h"
+#include "bench.h"
+#include "spmv_common.h"
+#include "csr_kernels.h"
+#include "verify.h"
+
 using namespace std;
 
-struct Triplet {
-    int row;
-    int col;
-    double val;
-};
+// Load, time and report one matrix with offset / index types P / I.
+template <typename P, typename I>
+static int run_sequential(const string& filename, const BenchOptions& bench) {
+    // Load matrix (binary CSR cache, or parse .mtx and convert COO -> CSR)
+    BasicCsrMatrix<double, P, I> csr;
+    if (!load_matrix(filename, csr)) {
+        return 1;
+    }
+    const I rows = csr.rows;
+    const I cols = csr.cols;
 
-bool compareTriplets(const Triplet& a, const Triplet& b) {
-    if (a.row < b.row) return true;
-    if (a.row == b.row) return a.col < b.col;
-    return false;
-}
+    // Generate random input vector in [-1000, 1000]
+    vector<double> v_input(cols);
+    fill_random_input(v_input, bench_seed(bench, random_device()()));
 
-struct CsrMatrix {
-    int rows = 0;
-    int cols = 0;
-    int nnz  = 0;
-    vector<int> row_ptr;
-    vector<int> col_ind;
-    vector<double> values;
-};
-
-// Sequential SpMV in CSR format
-void spmv_csr_sequential(const CsrMatrix& A,
-                         const vector<double>& v,
-                         vector<double>& c) {
-    const int* row_ptr   = A.row_ptr.data();
-    const int* col_ind   = A.col_ind.data();
-    const double* values = A.values.data();
-    const double* v_in   = v.data();
-    double* c_out        = c.data();
-
-    const int rows = A.rows;
-
-    for (int i = 0; i < rows; ++i) {
-        double sum = 0.0;
-        const int row_start = row_ptr[i];
-        const int row_end   = row_ptr[i + 1];
-        for (int j = row_start; j < row_end; ++j) {
-            sum += values[j] * v_in[col_ind[j]];
+    vector<double> c_output(rows, 0.0);
+
+    // Warm-up runs (not timed), then the timed runs
+    const vector<double> times_ms = bench_measure(bench, [&]() {
+        spmv_csr_sequential(csr, v_input, c_output);
+    });
+
+    if (bench.verify) {
+        const double tol = bench.verify_tol > 0.0 ? bench.verify_tol : VERIFY_TOL_FP64;
+        if (!report_verify("seq", verify_spmv(csr, v_input, 1, c_output, tol), tol, 1)) {
+            return 1;
         }
-        c_out[i] = sum;
     }
-}
 
-// Helper: extract matrix name from full path
-static string extract_matrix_name(const string& path) {
-    size_t pos = path.find_last_of("/\\");
-    string filename = (pos == string::npos) ? path : path.substr(pos + 1);
+    string matrix_name = extract_matrix_name(filename);
+
+    if (!bench.report.empty()) {
+        BenchReport report;
+        report.matrix   = matrix_name;
+        report.kernel   = "seq";
+        report.rows     = rows;
+        report.cols     = cols;
+        report.nnz      = csr.nnz;
+        report.flops    = 2.0 * csr.nnz;
+        report.bytes    = (double)sizeof(P) * (rows + 1) + (sizeof(I) + 8.0) * csr.nnz +
+                          8.0 * ((double)cols + rows);
+        report.warmup   = bench.warmup;
+        report.times_ms = times_ms;
+        bench_print_report(cout, bench.report, report);
+        return 0;
+    }
 
-    const string ext = ".mtx";
-    if (filename.size() > ext.size() &&
-        filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0) {
-        filename.erase(filename.size() - ext.size(), ext.size());
+    cout << matrix_name;
+    for (size_t run = 0; run < times_ms.size(); ++run) {
+        cout << "," << times_ms[run];
     }
-    return filename;
+    cout << "\n";
+
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
     // Expected CLI:
-    //   ./spmv_seq <matrix.mtx>
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <matrix.mtx>\n";
+    //   ./spmv_seq <matrix.mtx> [options]
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <matrix.mtx> [options]\n";
+        cerr << "Options:\n";
+        cerr << "  --warmup N               untimed calls before timing (default: 1)\n";
+        cerr << "  --runs N                 minimum number of timed calls (default: 10)\n";
+        cerr << "  --min-time MS            time calls until they add up to MS ms\n";
+        cerr << "  --report csv|json        statistics, GFLOP/s, GB/s and build / host\n";
+        cerr << "                           metadata instead of the per-run CSV line\n";
+        cerr << "  --seed N                 seed of the random input vector (default: random)\n";
+        cerr << "  --verify                 check the result against a Kahan-summed sequential\n";
+        cerr << "                           CSR reference after the timed calls\n";
+        cerr << "  --verify-tol T           scaled error tolerance of --verify (default: 1e-10)\n";
         return 1;
     }
 
     string filename = argv[1];
 
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Error: could not open file " << filename << "\n";
-        return 1;
-    }
-
-    vector<Triplet> triplets;
-    int rows, cols, nnz;
-    string line;
-
-    // Skip comments
-    while (getline(file, line)) {
-        if (line.empty()) continue;
-        if (line[0] != '%') break;
-    }
-
-    stringstream ss(line);
-    ss >> rows >> cols >> nnz;
-    triplets.reserve(nnz);
-
-    int r, c;
-    double v;
-    for (int i = 0; i < nnz; ++i) {
-        if (!(file >> r >> c >> v)) {
-            cerr << "Error reading matrix data.\n";
+    BenchOptions bench;
+    for (int i = 2; i < argc; ++i) {
+        bool bench_ok = true;
+        if (bench_parse_option(argc, argv, i, bench, bench_ok)) {
+            if (!bench_ok) return 1;
+        } else {
+            cerr << "Error: unknown or incomplete option " << argv[i] << "\n";
             return 1;
         }
-        Triplet t;
-        t.row = r - 1;
-        t.col = c - 1;
-        t.val = v;
-        triplets.push_back(t);
-    }
-    file.close();
-
-    // Convert COO -> CSR
-    sort(triplets.begin(), triplets.end(), compareTriplets);
-
-    CsrMatrix csr;
-    csr.rows = rows;
-    csr.cols = cols;
-    csr.nnz  = nnz;
-    csr.row_ptr.assign(rows + 1, 0);
-    csr.col_ind.resize(nnz);
-    csr.values.resize(nnz);
-
-    int current_row = 0;
-    for (int i = 0; i < nnz; ++i) {
-        csr.col_ind[i] = triplets[i].col;
-        csr.values[i]  = triplets[i].val;
-
-        while (current_row < triplets[i].row) {
-            ++current_row;
-            csr.row_ptr[current_row] = i;
-        }
-    }
-    for (int i = current_row + 1; i <= rows; ++i) {
-        csr.row_ptr[i] = nnz;
     }
 
-    // Generate random input vector in [-1000, 1000]
-    vector<double> v_input(cols);
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<double> dist(-1000.0, 1000.0);
-    for (int i = 0; i < cols; ++i) {
-        v_input[i] = dist(gen);
-    }
-
-    vector<double> c_output(rows, 0.0);
-
-    // Warm-up run (not timed)
-    spmv_csr_sequential(csr, v_input, c_output);
-
-    // Timed runs
-    const int NUM_RUNS = 10;
-    vector<double> times_ms(NUM_RUNS);
-
-    for (int run = 0; run < NUM_RUNS; ++run) {
-        auto start = chrono::high_resolution_clock::now();
-        spmv_csr_sequential(csr, v_input, c_output);
-        auto end   = chrono::high_resolution_clock::now();
-        chrono::duration<double, milli> elapsed = end - start;
-        times_ms[run] = elapsed.count();
+    // Narrowest index width that fits the matrix (csr_index_width)
+    CsrIndexWidth width = CSR_INDEX_32;
+    if (!matrix_index_width(filename, SYM_EXPAND, width)) {
+        return 1;
     }
-
-    string matrix_name = extract_matrix_name(filename);
-
-    cout << matrix_name;
-    for (int run = 0; run < NUM_RUNS; ++run) {
-        cout << "," << times_ms[run];
+    if (width == CSR_OFFSET_64) {
+        return run_sequential<long long, int>(filename, bench);
+    } else if (width == CSR_INDEX_64) {
+        return run_sequential<long long, long long>(filename, bench);
     }
-    cout << "\n";
-
-    return 0;
+    return run_sequential<int, int>(filename, bench);
 }
 
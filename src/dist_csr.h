@@ -0,0 +1,278 @@
+#ifndef DIST_CSR_H
+#define DIST_CSR_H
+
+#include <vector>
+#include <algorithm>
+
+#include <mpi.h>
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// Distributed CSR: MPI row decomposition with a halo exchange of v_in
+// ---------------------------------------------------------------------------
+//
+// Rank r owns the rows [row_offsets[r], row_offsets[r + 1]) of an
+// nnz-balanced RowPartition and the same range of v_in and c (for square
+// matrices; rectangular ones split v_in evenly). Its row block is split once
+// into
+//
+//   local:  entries whose column is owned by r, column index relative to
+//           col_offsets[r], so they read the rank's own slice of v_in
+//   remote: all other entries, column index into the ghost buffer, which
+//           holds each needed remote v_in entry exactly once
+//
+// The communication plan lists, per neighbour rank, which ghost entries
+// come from it and which owned entries it needs (exchanged once with
+// MPI_Alltoall / MPI_Alltoallv). A SpMV posts the receives, packs and sends
+// the requested entries, multiplies the local part while the messages are
+// in flight, waits, and adds the remote part. Only the calling (master)
+// thread makes MPI calls (MPI_THREAD_FUNNELED); the two kernels are OpenMP
+// loops with schedule(runtime).
+
+struct DistCsrMatrix {
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int rank   = 0;
+    int nranks = 1;
+    int global_rows = 0;
+    int global_cols = 0;
+    std::vector<int> row_offsets;    // nranks + 1: rows (and c) per rank
+    std::vector<int> col_offsets;    // nranks + 1: v_in entries per rank
+
+    CsrMatrix local;                 // owned columns, local index
+    CsrMatrix remote;                // ghost columns, index into ghost
+
+    // Receive side: ghost[recv_displs[k] .. + recv_counts[k]) from recv_ranks[k]
+    std::vector<int> recv_ranks, recv_counts, recv_displs;
+    // Send side: v_local[send_index[send_displs[k] .. + send_counts[k])] to send_ranks[k]
+    std::vector<int> send_ranks, send_counts, send_displs, send_index;
+
+    std::vector<double> ghost;
+    std::vector<double> send_buffer;
+    std::vector<MPI_Request> requests;
+
+    int local_rows() const { return row_offsets[rank + 1] - row_offsets[rank]; }
+    int local_cols() const { return col_offsets[rank + 1] - col_offsets[rank]; }
+};
+
+// Split the rows [row_begin, row_end) of the block (row_ptr relative to the
+// block) into local and remote parts and build the communication plan.
+// Collective over d.comm.
+inline void dist_csr_build(DistCsrMatrix& d, const std::vector<int>& row_ptr,
+                           const std::vector<int>& col_ind, const std::vector<double>& values) {
+    const int rows      = d.local_rows();
+    const int col_begin = d.col_offsets[d.rank];
+    const int col_end   = d.col_offsets[d.rank + 1];
+
+    // Ghost columns: every remote column once, in ascending order, which
+    // also groups them by owner rank
+    std::vector<int> ghost_cols;
+    for (size_t j = 0; j < col_ind.size(); ++j) {
+        if (col_ind[j] < col_begin || col_ind[j] >= col_end) ghost_cols.push_back(col_ind[j]);
+    }
+    std::sort(ghost_cols.begin(), ghost_cols.end());
+    ghost_cols.erase(std::unique(ghost_cols.begin(), ghost_cols.end()), ghost_cols.end());
+
+    CsrMatrix& L = d.local;
+    CsrMatrix& R = d.remote;
+    L.rows = R.rows = rows;
+    L.cols = d.local_cols();
+    R.cols = static_cast<int>(ghost_cols.size());
+    L.row_ptr.assign(rows + 1, 0);
+    R.row_ptr.assign(rows + 1, 0);
+    L.col_ind.clear();
+    L.values.clear();
+    R.col_ind.clear();
+    R.values.clear();
+    for (int i = 0; i < rows; ++i) {
+        for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+            const int col = col_ind[j];
+            if (col >= col_begin && col < col_end) {
+                L.col_ind.push_back(col - col_begin);
+                L.values.push_back(values[j]);
+            } else {
+                const int g = static_cast<int>(
+                    std::lower_bound(ghost_cols.begin(), ghost_cols.end(), col) -
+                    ghost_cols.begin());
+                R.col_ind.push_back(g);
+                R.values.push_back(values[j]);
+            }
+        }
+        L.row_ptr[i + 1] = static_cast<int>(L.col_ind.size());
+        R.row_ptr[i + 1] = static_cast<int>(R.col_ind.size());
+    }
+    L.nnz = L.row_ptr[rows];
+    R.nnz = R.row_ptr[rows];
+
+    // How many ghost entries come from every rank
+    std::vector<int> need(d.nranks, 0);
+    for (size_t g = 0; g < ghost_cols.size(); ++g) {
+        const int owner = static_cast<int>(
+            std::upper_bound(d.col_offsets.begin(), d.col_offsets.end(), ghost_cols[g]) -
+            d.col_offsets.begin()) - 1;
+        ++need[owner];
+    }
+    std::vector<int> give(d.nranks, 0);
+    MPI_Alltoall(need.data(), 1, MPI_INT, give.data(), 1, MPI_INT, d.comm);
+
+    // Tell every owner which of its columns are needed
+    std::vector<int> need_displs(d.nranks + 1, 0), give_displs(d.nranks + 1, 0);
+    for (int r = 0; r < d.nranks; ++r) {
+        need_displs[r + 1] = need_displs[r] + need[r];
+        give_displs[r + 1] = give_displs[r] + give[r];
+    }
+    std::vector<int> requested(give_displs[d.nranks]);
+    MPI_Alltoallv(ghost_cols.data(), need.data(), need_displs.data(), MPI_INT,
+                  requested.data(), give.data(), give_displs.data(), MPI_INT, d.comm);
+
+    d.recv_ranks.clear();
+    d.recv_counts.clear();
+    d.recv_displs.clear();
+    d.send_ranks.clear();
+    d.send_counts.clear();
+    d.send_displs.clear();
+    for (int r = 0; r < d.nranks; ++r) {
+        if (need[r] > 0) {
+            d.recv_ranks.push_back(r);
+            d.recv_counts.push_back(need[r]);
+            d.recv_displs.push_back(need_displs[r]);
+        }
+        if (give[r] > 0) {
+            d.send_ranks.push_back(r);
+            d.send_counts.push_back(give[r]);
+            d.send_displs.push_back(give_displs[r]);
+        }
+    }
+    d.send_index.resize(requested.size());
+    for (size_t k = 0; k < requested.size(); ++k) d.send_index[k] = requested[k] - col_begin;
+
+    d.ghost.assign(ghost_cols.size(), 0.0);
+    d.send_buffer.assign(requested.size(), 0.0);
+    d.requests.resize(d.recv_ranks.size() + d.send_ranks.size());
+}
+
+// Rank 0 holds A (ignored elsewhere): split its rows over the ranks by nnz,
+// send every block to its owner and build the local/remote split everywhere.
+// Collective over comm.
+inline void dist_csr_scatter(const CsrMatrix& A, MPI_Comm comm, DistCsrMatrix& d) {
+    d.comm = comm;
+    MPI_Comm_rank(comm, &d.rank);
+    MPI_Comm_size(comm, &d.nranks);
+
+    int dims[2] = {A.rows, A.cols};
+    MPI_Bcast(dims, 2, MPI_INT, 0, comm);
+    d.global_rows = dims[0];
+    d.global_cols = dims[1];
+
+    RowPartition part;
+    if (d.rank == 0) partition_rows_by_nnz(A, d.nranks, part);
+    d.row_offsets.resize(d.nranks + 1);
+    if (d.rank == 0) d.row_offsets = part.row_begin;
+    MPI_Bcast(d.row_offsets.data(), d.nranks + 1, MPI_INT, 0, comm);
+
+    // v_in follows the rows of square matrices
+    d.col_offsets.resize(d.nranks + 1);
+    for (int r = 0; r <= d.nranks; ++r) {
+        d.col_offsets[r] = (d.global_rows == d.global_cols)
+                               ? d.row_offsets[r]
+                               : static_cast<int>((long long)d.global_cols * r / d.nranks);
+    }
+
+    std::vector<int> row_ptr, col_ind;
+    std::vector<double> values;
+    const int rows = d.local_rows();
+    if (d.rank == 0) {
+        for (int r = d.nranks - 1; r >= 0; --r) {
+            const int r0 = d.row_offsets[r];
+            const int r1 = d.row_offsets[r + 1];
+            const int first = A.row_ptr[r0];
+            const int count = A.row_ptr[r1] - first;
+            std::vector<int> block_ptr(r1 - r0 + 1);
+            for (int i = r0; i <= r1; ++i) block_ptr[i - r0] = A.row_ptr[i] - first;
+            if (r == 0) {
+                row_ptr.swap(block_ptr);
+                col_ind.assign(A.col_ind.begin() + first, A.col_ind.begin() + first + count);
+                values.assign(A.values.begin() + first, A.values.begin() + first + count);
+            } else {
+                MPI_Send(block_ptr.data(), r1 - r0 + 1, MPI_INT, r, 0, comm);
+                MPI_Send(A.col_ind.data() + first, count, MPI_INT, r, 1, comm);
+                MPI_Send(A.values.data() + first, count, MPI_DOUBLE, r, 2, comm);
+            }
+        }
+    } else {
+        row_ptr.resize(rows + 1);
+        MPI_Recv(row_ptr.data(), rows + 1, MPI_INT, 0, 0, comm, MPI_STATUS_IGNORE);
+        col_ind.resize(row_ptr[rows]);
+        values.resize(row_ptr[rows]);
+        MPI_Recv(col_ind.data(), row_ptr[rows], MPI_INT, 0, 1, comm, MPI_STATUS_IGNORE);
+        MPI_Recv(values.data(), row_ptr[rows], MPI_DOUBLE, 0, 2, comm, MPI_STATUS_IGNORE);
+    }
+
+    dist_csr_build(d, row_ptr, col_ind, values);
+}
+
+// c_local = (A v)[own rows], v_local = own slice of v_in. With overlap the
+// local part is multiplied while the halo is in flight; without, the
+// exchange completes first (for comparison).
+inline void dist_spmv(DistCsrMatrix& d, const std::vector<double>& v_local,
+                      std::vector<double>& c_local, bool overlap) {
+    const int nrecv = static_cast<int>(d.recv_ranks.size());
+    const int nsend = static_cast<int>(d.send_ranks.size());
+    for (int k = 0; k < nrecv; ++k) {
+        MPI_Irecv(d.ghost.data() + d.recv_displs[k], d.recv_counts[k], MPI_DOUBLE,
+                  d.recv_ranks[k], 0, d.comm, &d.requests[k]);
+    }
+
+    const int nsend_entries = static_cast<int>(d.send_index.size());
+    const int* send_index = d.send_index.data();
+    const double* v_in = v_local.data();
+    double* send_buffer = d.send_buffer.data();
+    #pragma omp parallel for schedule(static)
+    for (int k = 0; k < nsend_entries; ++k) {
+        send_buffer[k] = v_in[send_index[k]];
+    }
+    for (int k = 0; k < nsend; ++k) {
+        MPI_Isend(send_buffer + d.send_displs[k], d.send_counts[k], MPI_DOUBLE,
+                  d.send_ranks[k], 0, d.comm, &d.requests[nrecv + k]);
+    }
+
+    if (!overlap) {
+        MPI_Waitall(nrecv + nsend, d.requests.data(), MPI_STATUSES_IGNORE);
+    }
+
+    const int rows = d.local_rows();
+    double* c_out = c_local.data();
+    {
+        const int* row_ptr = d.local.row_ptr.data();
+        const int* col_ind = d.local.col_ind.data();
+        const double* values = d.local.values.data();
+        #pragma omp parallel for schedule(runtime)
+        for (int i = 0; i < rows; ++i) {
+            double sum = 0.0;
+            for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                sum += values[j] * v_in[col_ind[j]];
+            }
+            c_out[i] = sum;
+        }
+    }
+
+    if (overlap) {
+        MPI_Waitall(nrecv + nsend, d.requests.data(), MPI_STATUSES_IGNORE);
+    }
+
+    // Remote part: only rows with ghost entries do any work
+    const int* row_ptr = d.remote.row_ptr.data();
+    const int* col_ind = d.remote.col_ind.data();
+    const double* values = d.remote.values.data();
+    const double* ghost = d.ghost.data();
+    #pragma omp parallel for schedule(runtime)
+    for (int i = 0; i < rows; ++i) {
+        double sum = 0.0;
+        for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+            sum += values[j] * ghost[col_ind[j]];
+        }
+        c_out[i] += sum;
+    }
+}
+
+#endif // DIST_CSR_H
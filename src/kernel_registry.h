@@ -0,0 +1,401 @@
+#ifndef KERNEL_REGISTRY_H
+#define KERNEL_REGISTRY_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <sstream>
+
+#include "csr_matrix.h"
+#include "csr_kernels.h"
+#include "sell.h"
+#include "bcsr.h"
+#include "csr_delta.h"
+#include "csr_tiled.h"
+#include "csr_offload.h"
+
+// ---------------------------------------------------------------------------
+// Kernel registry
+// ---------------------------------------------------------------------------
+//
+// A kernel is registered under a name with a factory that takes a loaded
+// (and possibly reordered) CsrMatrix with general storage and builds an
+// SpmvEngine: the format conversion and work split are done once by the
+// factory, multiply() is the timed call. New engines are added with
+// register_kernel() and can then be selected at run time (spmv --kernel)
+// next to the built-in ones, on the same matrix and input vector.
+//
+// Engines built on the CSR arrays keep a reference to the matrix, which
+// must outlive them. The OpenMP thread count and runtime schedule are taken
+// from the caller's settings (omp_set_num_threads / omp_set_schedule).
+
+// Parameters of the built-in engines; each uses the ones it needs
+struct KernelOptions {
+    int threads    = 1;     // row blocks of the balanced / merge / persistent splits
+    int chunk      = 0;     // steal: rows the owner takes at a time
+    int sell_c     = 8;
+    int sell_sigma = 256;
+    SellIsa sell_isa = SELL_ISA_AUTO;
+    int block_r    = 0;     // 0: BCSR block size from choose_bcsr_block
+    int block_c    = 0;
+    int tile_kb    = 0;     // 0: tiled panel width from tune_tiled_csr
+};
+
+class SpmvEngine {
+public:
+    virtual ~SpmvEngine() {}
+
+    // c = A v
+    virtual void multiply(const std::vector<double>& v, std::vector<double>& c) = 0;
+
+    // Label of the engine with its parameters, e.g. "sell-8-256"
+    virtual std::string label() const = 0;
+
+    // Bytes streamed per call besides one read of v and one write of c
+    virtual double traffic_bytes() const = 0;
+
+    // One line about the built format (padding, fill, ...), may be empty
+    virtual std::string describe() const { return std::string(); }
+
+    // True for engines that store or accumulate in fp32 (looser --verify
+    // tolerance)
+    virtual bool reduced_precision() const { return false; }
+
+    // Store the parameters the engine picked by itself (BCSR block size,
+    // tile width) in opts, so the same engine can be rebuilt without tuning
+    virtual void resolved_options(KernelOptions& opts) const { (void)opts; }
+};
+
+// Returns an engine for A, or nullptr (after printing an error) if the
+// format cannot represent the matrix
+typedef std::unique_ptr<SpmvEngine> (*SpmvEngineFactory)(const CsrMatrix& A,
+                                                         const KernelOptions& opts);
+
+struct KernelEntry {
+    std::string name;
+    std::string description;
+    SpmvEngineFactory create;
+};
+
+// Bytes of the CSR arrays with value size value_bytes
+inline double csr_traffic_bytes(const CsrMatrix& A, double value_bytes) {
+    return 4.0 * (A.rows + 1) + (4.0 + value_bytes) * A.nnz;
+}
+
+// ---------------------------------------------------------------------------
+// Built-in engines
+// ---------------------------------------------------------------------------
+
+// Sequential or schedule(runtime) CSR
+class CsrRuntimeEngine : public SpmvEngine {
+public:
+    CsrRuntimeEngine(const CsrMatrix& A, bool sequential) : A_(A), sequential_(sequential) {}
+
+    void multiply(const std::vector<double>& v, std::vector<double>& c) {
+        if (sequential_) {
+            spmv_csr_sequential(A_, v, c);
+        } else {
+            spmv_csr_parallel(A_, v, c);
+        }
+    }
+    std::string label() const { return sequential_ ? "seq" : "csr"; }
+    double traffic_bytes() const { return csr_traffic_bytes(A_, 8.0); }
+
+private:
+    const CsrMatrix& A_;
+    bool sequential_;
+};
+
+// CSR over a work split computed once: nnz-balanced blocks, merge path,
+// blocks on a persistent thread team, or blocks with work stealing
+class CsrSplitEngine : public SpmvEngine {
+public:
+    CsrSplitEngine(const CsrMatrix& A, CsrSchedule schedule, const KernelOptions& opts) : A_(A) {
+        build_csr_split(A, schedule, opts.threads, opts.chunk, plan_);
+    }
+
+    void multiply(const std::vector<double>& v, std::vector<double>& c) {
+        spmv_csr_split(A_, plan_, v, c);
+    }
+    std::string label() const {
+        static const char* labels[] = {"csr", "csr-balanced", "csr-merge", "csr-persistent",
+                                       "csr-steal"};
+        return labels[plan_.schedule];
+    }
+    double traffic_bytes() const { return csr_traffic_bytes(A_, 8.0); }
+
+private:
+    const CsrMatrix& A_;
+    CsrSplitPlan plan_;
+};
+
+// fp32 values, fp64 vectors and accumulation
+class CsrFp32Engine : public SpmvEngine {
+public:
+    explicit CsrFp32Engine(const CsrMatrix& A) { csr_convert_values(A, csr32_); }
+
+    void multiply(const std::vector<double>& v, std::vector<double>& c) {
+        spmv_csr_parallel(csr32_, v, c);
+    }
+    std::string label() const { return "fp32-acc64"; }
+    bool reduced_precision() const { return true; }
+    double traffic_bytes() const {
+        return 4.0 * (csr32_.rows + 1) + 8.0 * csr32_.nnz;
+    }
+
+private:
+    BasicCsrMatrix<float> csr32_;
+};
+
+class SellEngine : public SpmvEngine {
+public:
+    bool build(const CsrMatrix& A, const KernelOptions& opts) {
+        isa_ = sell_select_isa(opts.sell_c, opts.sell_isa);
+        return build_sell_c_sigma(A, opts.sell_c, opts.sell_sigma, sell_);
+    }
+
+    void multiply(const std::vector<double>& v, std::vector<double>& c) {
+        spmv_sell(sell_, isa_, v, c);
+    }
+    std::string label() const {
+        return "sell-" + std::to_string(sell_.C) + "-" + std::to_string(sell_.sigma);
+    }
+    double traffic_bytes() const {
+        return 4.0 * (sell_.chunk_ptr.size() + sell_.chunk_len.size() + sell_.perm.size()) +
+               12.0 * sell_.stored();
+    }
+    std::string describe() const {
+        std::ostringstream out;
+        out << sell_.stored() << " stored entries for " << sell_.nnz
+            << " nonzeros (padding overhead " << 100.0 * sell_.padding_overhead()
+            << "%), isa " << sell_isa_name(isa_);
+        return out.str();
+    }
+
+private:
+    SellCSigmaMatrix sell_;
+    SellIsa isa_;
+};
+
+class BcsrEngine : public SpmvEngine {
+public:
+    BcsrEngine(const CsrMatrix& A, const KernelOptions& opts) {
+        int R = opts.block_r, C = opts.block_c;
+        if (R == 0) {
+            const BcsrBlockEstimate best = choose_bcsr_block(A);
+            R = best.R;
+            C = best.C;
+        }
+        build_bcsr(A, R, C, bcsr_);
+    }
+
+    void multiply(const std::vector<double>& v, std::vector<double>& c) {
+        spmv_bcsr(bcsr_, v, c);
+    }
+    std::string label() const {
+        return "bcsr-" + std::to_string(bcsr_.R) + "x" + std::to_string(bcsr_.C);
+    }
+    double traffic_bytes() const {
+        return 4.0 * (bcsr_.brow_ptr.size() + bcsr_.bcol_ind.size()) + 8.0 * bcsr_.values.size();
+    }
+    std::string describe() const {
+        std::ostringstream out;
+        out << bcsr_.num_blocks << " blocks for " << bcsr_.nnz << " nonzeros (fill ratio "
+            << bcsr_.fill_ratio() << ")";
+        return out.str();
+    }
+    void resolved_options(KernelOptions& opts) const {
+        opts.block_r = bcsr_.R;
+        opts.block_c = bcsr_.C;
+    }
+
+private:
+    BcsrMatrix bcsr_;
+};
+
+class CsrDeltaEngine : public SpmvEngine {
+public:
+    bool build(const CsrMatrix& A) { return build_csr_delta(A, delta_); }
+
+    void multiply(const std::vector<double>& v, std::vector<double>& c) {
+        spmv_csr_delta(delta_, v, c);
+    }
+    std::string label() const { return "csr-delta"; }
+    double traffic_bytes() const { return delta_.bytes_per_nnz() * delta_.nnz; }
+    std::string describe() const {
+        std::ostringstream out;
+        out << delta_.bytes_per_nnz() << " B/nnz, " << delta_.escapes << " escaped column gaps";
+        if (delta_.fallback) out << " (no gain over CSR: CSR kernel)";
+        return out.str();
+    }
+
+private:
+    CsrDeltaMatrix delta_;
+};
+
+class TiledEngine : public SpmvEngine {
+public:
+    TiledEngine(const CsrMatrix& A, const KernelOptions& opts) : tile_kb_(opts.tile_kb) {
+        if (tile_kb_ == 0) {
+            tile_kb_ = tune_tiled_csr(A, tiled_);
+        } else {
+            build_tiled_csr(A, tile_panel_cols(A.cols, tile_kb_), tiled_);
+        }
+    }
+
+    void multiply(const std::vector<double>& v, std::vector<double>& c) {
+        spmv_csr_tiled(tiled_, v, c);
+    }
+    std::string label() const { return "tiled-" + std::to_string(tile_kb_) + "kb"; }
+    double traffic_bytes() const {
+        return 4.0 * (tiled_.panel_row.size() + tiled_.row_ind.size() + tiled_.row_start.size()) +
+               12.0 * tiled_.nnz + 16.0 * tiled_.row_ind.size();   // c += per panel row
+    }
+    std::string describe() const {
+        std::ostringstream out;
+        out << tiled_.num_panels << " panels of " << tiled_.panel_cols << " columns, "
+            << tiled_.row_ind.size() << " panel rows";
+        return out.str();
+    }
+    void resolved_options(KernelOptions& opts) const { opts.tile_kb = tile_kb_; }
+
+private:
+    TiledCsrMatrix tiled_;
+    int tile_kb_;
+};
+
+// Device CSR (csr_offload.h): the matrix stays on the device, every call
+// moves v up and c down, so the time is comparable end to end
+class OffloadEngine : public SpmvEngine {
+public:
+    explicit OffloadEngine(const CsrMatrix& A) : device_(A, DEVICE_KERNEL_AUTO) {}
+
+    void multiply(const std::vector<double>& v, std::vector<double>& c) {
+        device_.multiply(v, c);
+    }
+    std::string label() const {
+        return std::string("offload-") + device_kernel_name(device_.kernel());
+    }
+    double traffic_bytes() const { return device_.matrix_bytes(); }
+    std::string describe() const {
+        std::ostringstream out;
+        out << (device_.on_host() ? "no device, runs on the host" : "on the device")
+            << ", matrix upload " << device_.upload_ms() << " ms";
+        return out.str();
+    }
+
+private:
+    DeviceCsr device_;
+};
+
+inline std::unique_ptr<SpmvEngine> make_seq_engine(const CsrMatrix& A, const KernelOptions&) {
+    return std::unique_ptr<SpmvEngine>(new CsrRuntimeEngine(A, true));
+}
+
+inline std::unique_ptr<SpmvEngine> make_csr_engine(const CsrMatrix& A, const KernelOptions&) {
+    return std::unique_ptr<SpmvEngine>(new CsrRuntimeEngine(A, false));
+}
+
+inline std::unique_ptr<SpmvEngine> make_balanced_engine(const CsrMatrix& A,
+                                                        const KernelOptions& opts) {
+    return std::unique_ptr<SpmvEngine>(new CsrSplitEngine(A, CSR_SCHEDULE_BALANCED, opts));
+}
+
+inline std::unique_ptr<SpmvEngine> make_merge_engine(const CsrMatrix& A,
+                                                     const KernelOptions& opts) {
+    return std::unique_ptr<SpmvEngine>(new CsrSplitEngine(A, CSR_SCHEDULE_MERGE, opts));
+}
+
+inline std::unique_ptr<SpmvEngine> make_persistent_engine(const CsrMatrix& A,
+                                                          const KernelOptions& opts) {
+    return std::unique_ptr<SpmvEngine>(new CsrSplitEngine(A, CSR_SCHEDULE_PERSISTENT, opts));
+}
+
+inline std::unique_ptr<SpmvEngine> make_steal_engine(const CsrMatrix& A,
+                                                     const KernelOptions& opts) {
+    return std::unique_ptr<SpmvEngine>(new CsrSplitEngine(A, CSR_SCHEDULE_STEAL, opts));
+}
+
+inline std::unique_ptr<SpmvEngine> make_fp32_engine(const CsrMatrix& A, const KernelOptions&) {
+    return std::unique_ptr<SpmvEngine>(new CsrFp32Engine(A));
+}
+
+inline std::unique_ptr<SpmvEngine> make_sell_engine(const CsrMatrix& A,
+                                                    const KernelOptions& opts) {
+    std::unique_ptr<SellEngine> engine(new SellEngine());
+    if (!engine->build(A, opts)) return std::unique_ptr<SpmvEngine>();
+    return std::unique_ptr<SpmvEngine>(engine.release());
+}
+
+inline std::unique_ptr<SpmvEngine> make_bcsr_engine(const CsrMatrix& A,
+                                                    const KernelOptions& opts) {
+    return std::unique_ptr<SpmvEngine>(new BcsrEngine(A, opts));
+}
+
+inline std::unique_ptr<SpmvEngine> make_csr_delta_engine(const CsrMatrix& A,
+                                                         const KernelOptions&) {
+    std::unique_ptr<CsrDeltaEngine> engine(new CsrDeltaEngine());
+    if (!engine->build(A)) return std::unique_ptr<SpmvEngine>();
+    return std::unique_ptr<SpmvEngine>(engine.release());
+}
+
+inline std::unique_ptr<SpmvEngine> make_tiled_engine(const CsrMatrix& A,
+                                                     const KernelOptions& opts) {
+    return std::unique_ptr<SpmvEngine>(new TiledEngine(A, opts));
+}
+
+inline std::unique_ptr<SpmvEngine> make_offload_engine(const CsrMatrix& A, const KernelOptions&) {
+    return std::unique_ptr<SpmvEngine>(new OffloadEngine(A));
+}
+
+// ---------------------------------------------------------------------------
+// Registry
+// ---------------------------------------------------------------------------
+
+// All registered kernels; the built-in ones are registered on first use
+inline std::vector<KernelEntry>& kernel_registry() {
+    static std::vector<KernelEntry> registry = {
+        {"seq",            "sequential CSR", make_seq_engine},
+        {"csr",            "CSR, OpenMP schedule(runtime)", make_csr_engine},
+        {"csr-balanced",   "CSR, contiguous nnz-balanced row blocks", make_balanced_engine},
+        {"csr-merge",      "CSR, merge-path split of rows + nnz", make_merge_engine},
+        {"csr-persistent", "CSR, balanced blocks on a persistent thread team",
+                           make_persistent_engine},
+        {"csr-steal",      "CSR, balanced blocks with work stealing (chunk rows)",
+                           make_steal_engine},
+        {"fp32-acc64",     "CSR, fp32 values with fp64 accumulation", make_fp32_engine},
+        {"csr-delta",      "CSR with delta-compressed column indices", make_csr_delta_engine},
+        {"sell",           "SELL-C-sigma (--sell-c, --sell-sigma, --sell-isa)", make_sell_engine},
+        {"bcsr",           "register-blocked CSR (--block)", make_bcsr_engine},
+        {"tiled",          "column-tiled CSR (--tile-kb)", make_tiled_engine},
+        {"offload",        "device CSR (OpenMP target), vector transfers included",
+                           make_offload_engine},
+    };
+    return registry;
+}
+
+// Add a kernel, or replace the one registered under the same name
+inline void register_kernel(const std::string& name, const std::string& description,
+                            SpmvEngineFactory create) {
+    std::vector<KernelEntry>& registry = kernel_registry();
+    for (size_t k = 0; k < registry.size(); ++k) {
+        if (registry[k].name == name) {
+            registry[k].description = description;
+            registry[k].create      = create;
+            return;
+        }
+    }
+    KernelEntry entry = {name, description, create};
+    registry.push_back(entry);
+}
+
+// Registered kernel with this name, or nullptr
+inline const KernelEntry* find_kernel(const std::string& name) {
+    const std::vector<KernelEntry>& registry = kernel_registry();
+    for (size_t k = 0; k < registry.size(); ++k) {
+        if (registry[k].name == name) return &registry[k];
+    }
+    return nullptr;
+}
+
+#endif // KERNEL_REGISTRY_H
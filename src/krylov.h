@@ -0,0 +1,321 @@
+#ifndef KRYLOV_H
+#define KRYLOV_H
+
+#include <vector>
+#include <cmath>
+
+#include "csr_matrix.h"
+#include "numa.h"
+#include "thread_team.h"
+
+// ---------------------------------------------------------------------------
+// Krylov solvers (CG, BiCGSTAB) on CSR
+// ---------------------------------------------------------------------------
+//
+// Each solver runs in a single team call: one OpenMP parallel region, or
+// one run() of a persistent ThreadTeam (thread_team.h). Thread t owns the
+// rows of block t of an nnz-balanced RowPartition, both for the SpMV and for
+// every vector update, so vector entries stay with the thread that produces
+// and consumes them. When the region gets fewer threads than blocks
+// (team.active() < part.nparts), each thread owns a contiguous run of blocks
+// instead (krylov_rows) and the partial slots of the missing threads stay 0.
+// Dot products are fused into the loop that produces their operands
+// (e.g. q = A p together with p . q); the per-thread partials go to
+// cache-line padded slots, and after one barrier every thread adds them up
+// in the same order, so all threads see the same scalar without a second
+// barrier or a master broadcast. CG needs 3 barriers per iteration and
+// BiCGSTAB 5.
+//
+// The work vectors are allocated serially, so their pages are released
+// (numa_release_pages) and first written by the owning thread in the setup
+// loop, as in numa_first_touch. x starts at 0; convergence is
+// ||r|| / ||b|| <= tol. A solver stops with breakdown set when a step
+// cannot be taken: p . A p <= 0 in CG (A is not SPD), r_hat . v = 0 or
+// rho = omega = 0 in BiCGSTAB, or a non-finite residual. The test uses the
+// reduced scalars, so every thread takes the same decision.
+
+struct KrylovResult {
+    int iterations   = 0;
+    bool converged   = false;
+    bool breakdown   = false;      // stopped early, see above
+    double residual  = 0.0;        // final ||r|| / ||b||
+    std::vector<double> history;   // ||r|| / ||b|| after every iteration (0: initial)
+};
+
+// Per-thread reduction slots, one cache line (8 doubles) per thread.
+class PaddedPartials {
+public:
+    static const int STRIDE = 8;
+
+    explicit PaddedPartials(int nthreads)
+        : nthreads_(nthreads), storage_((size_t)(nthreads + 1) * STRIDE, 0.0) {
+        // Align the first slot to 64 bytes inside the buffer
+        double* p = storage_.data();
+        while (reinterpret_cast<size_t>(p) % 64 != 0) ++p;
+        base_ = p;
+    }
+
+    double& at(int tid, int slot) { return base_[(size_t)tid * STRIDE + slot]; }
+
+    // Sum of one slot over all threads, always in thread order
+    double sum(int slot) const {
+        double total = 0.0;
+        for (int t = 0; t < nthreads_; ++t) total += base_[(size_t)t * STRIDE + slot];
+        return total;
+    }
+
+private:
+    int nthreads_;
+    std::vector<double> storage_;
+    double* base_;
+};
+
+inline double csr_row_dot(const int* row_ptr, const int* col_ind, const double* values,
+                          int i, const double* x) {
+    double sum = 0.0;
+    for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+        sum += values[j] * x[col_ind[j]];
+    }
+    return sum;
+}
+
+// Rows [r0, r1) of thread tid of a team of nth <= part.nparts threads
+inline void krylov_rows(const RowPartition& part, int tid, int nth, int& r0, int& r1) {
+    r0 = part.row_begin[(long long)tid * part.nparts / nth];
+    r1 = part.row_begin[(long long)(tid + 1) * part.nparts / nth];
+}
+
+// Conjugate gradients for symmetric positive definite A, on a team of
+// part.nparts threads.
+template <typename Team>
+void cg_solve(Team& team, const CsrMatrix& A, const RowPartition& part,
+              const std::vector<double>& b, std::vector<double>& x,
+              double tol, int maxit, KrylovResult& result) {
+    const int n = A.rows;
+    const int* row_ptr   = A.row_ptr.data();
+    const int* col_ind   = A.col_ind.data();
+    const double* values = A.values.data();
+
+    std::vector<double> r(n), p(n), q(n);
+    x.assign(n, 0.0);
+    result = KrylovResult();
+    numa_release_pages(r.data(), n * sizeof(double));
+    numa_release_pages(p.data(), n * sizeof(double));
+    numa_release_pages(q.data(), n * sizeof(double));
+    numa_release_pages(x.data(), n * sizeof(double));
+
+    enum { SLOT_PQ, SLOT_RR, SLOT_BB };
+    PaddedPartials partial(part.nparts);
+
+    team.run([&](int tid) {
+        int r0 = 0, r1 = 0;
+        krylov_rows(part, tid, team.active(), r0, r1);
+
+        // r = p = b (x = 0)
+        double bb = 0.0;
+        for (int i = r0; i < r1; ++i) {
+            x[i] = 0.0;
+            q[i] = 0.0;
+            r[i] = b[i];
+            p[i] = b[i];
+            bb += b[i] * b[i];
+        }
+        partial.at(tid, SLOT_BB) = bb;
+        team.barrier(tid);
+        const double norm_b = std::sqrt(partial.sum(SLOT_BB));
+        const double scale  = norm_b > 0.0 ? 1.0 / norm_b : 1.0;
+        double rr = partial.sum(SLOT_BB);
+
+        bool breakdown = !std::isfinite(rr);
+
+        if (tid == 0) result.history.push_back(std::sqrt(rr) * scale);
+
+        int it = 0;
+        while (it < maxit && std::sqrt(rr) * scale > tol && !breakdown) {
+            // q = A p, fused with p . q  (p of all threads is complete here)
+            double pq = 0.0;
+            for (int i = r0; i < r1; ++i) {
+                const double qi = csr_row_dot(row_ptr, col_ind, values, i, p.data());
+                q[i] = qi;
+                pq += p[i] * qi;
+            }
+            partial.at(tid, SLOT_PQ) = pq;
+            team.barrier(tid);
+            const double pq_sum = partial.sum(SLOT_PQ);
+            if (!(pq_sum > 0.0)) {
+                breakdown = true;   // same decision on every thread
+                break;
+            }
+            const double alpha = rr / pq_sum;
+
+            // x += alpha p, r -= alpha q, fused with r . r
+            double rr_local = 0.0;
+            for (int i = r0; i < r1; ++i) {
+                x[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+                rr_local += r[i] * r[i];
+            }
+            partial.at(tid, SLOT_RR) = rr_local;
+            team.barrier(tid);
+            const double rr_new = partial.sum(SLOT_RR);
+            const double beta   = rr_new / rr;
+            rr = rr_new;
+            ++it;
+
+            if (tid == 0) result.history.push_back(std::sqrt(rr) * scale);
+            if (!std::isfinite(rr)) {
+                breakdown = true;
+                break;
+            }
+
+            // p = r + beta p; the next SpMV reads all of p
+            for (int i = r0; i < r1; ++i) {
+                p[i] = r[i] + beta * p[i];
+            }
+            team.barrier(tid);
+        }
+
+        if (tid == 0) {
+            result.iterations = it;
+            result.residual   = std::sqrt(rr) * scale;
+            result.converged  = result.residual <= tol;
+            result.breakdown  = breakdown;
+        }
+    });
+}
+
+// BiCGSTAB for general (nonsymmetric) A, on a team of part.nparts threads.
+template <typename Team>
+void bicgstab_solve(Team& team, const CsrMatrix& A, const RowPartition& part,
+                    const std::vector<double>& b, std::vector<double>& x,
+                    double tol, int maxit, KrylovResult& result) {
+    const int n = A.rows;
+    const int* row_ptr   = A.row_ptr.data();
+    const int* col_ind   = A.col_ind.data();
+    const double* values = A.values.data();
+
+    std::vector<double> r(n), r_hat(n), p(n), v(n), s(n), t(n);
+    x.assign(n, 0.0);
+    result = KrylovResult();
+    double* work[] = {r.data(), r_hat.data(), p.data(), v.data(), s.data(), t.data(), x.data()};
+    for (size_t k = 0; k < sizeof(work) / sizeof(work[0]); ++k) {
+        numa_release_pages(work[k], n * sizeof(double));
+    }
+
+    enum { SLOT_RV, SLOT_TS, SLOT_TT, SLOT_RR, SLOT_RHAT_R };
+    PaddedPartials partial(part.nparts);
+
+    team.run([&](int tid) {
+        int r0 = 0, r1 = 0;
+        krylov_rows(part, tid, team.active(), r0, r1);
+
+        // r = r_hat = b, x = p = v = 0
+        double bb = 0.0;
+        for (int i = r0; i < r1; ++i) {
+            x[i] = p[i] = v[i] = s[i] = t[i] = 0.0;
+            r[i]     = b[i];
+            r_hat[i] = b[i];
+            bb += b[i] * b[i];
+        }
+        partial.at(tid, SLOT_RR) = bb;
+        team.barrier(tid);
+        double rr = partial.sum(SLOT_RR);
+        const double scale = rr > 0.0 ? 1.0 / std::sqrt(rr) : 1.0;
+
+        double rho = rr;               // r_hat . r
+        double alpha = 1.0, omega = 1.0, rho_old = 1.0;
+        bool breakdown = false;
+
+        if (tid == 0) result.history.push_back(std::sqrt(rr) * scale);
+
+        int it = 0;
+        while (it < maxit && std::sqrt(rr) * scale > tol && !breakdown) {
+            // p = r + beta (p - omega v)
+            const double beta = (rho / rho_old) * (alpha / omega);
+            for (int i = r0; i < r1; ++i) {
+                p[i] = r[i] + beta * (p[i] - omega * v[i]);
+            }
+            team.barrier(tid);
+
+            // v = A p, fused with r_hat . v
+            double rv = 0.0;
+            for (int i = r0; i < r1; ++i) {
+                const double vi = csr_row_dot(row_ptr, col_ind, values, i, p.data());
+                v[i] = vi;
+                rv += r_hat[i] * vi;
+            }
+            partial.at(tid, SLOT_RV) = rv;
+            team.barrier(tid);
+            const double rv_sum = partial.sum(SLOT_RV);
+            if (rv_sum == 0.0) {
+                breakdown = true;   // same decision on every thread
+                break;
+            }
+            alpha = rho / rv_sum;
+
+            // s = r - alpha v; the next SpMV reads all of s
+            for (int i = r0; i < r1; ++i) {
+                s[i] = r[i] - alpha * v[i];
+            }
+            team.barrier(tid);
+
+            // t = A s, fused with t . s and t . t
+            double ts = 0.0, tt = 0.0;
+            for (int i = r0; i < r1; ++i) {
+                const double ti = csr_row_dot(row_ptr, col_ind, values, i, s.data());
+                t[i] = ti;
+                ts += ti * s[i];
+                tt += ti * ti;
+            }
+            partial.at(tid, SLOT_TS) = ts;
+            partial.at(tid, SLOT_TT) = tt;
+            team.barrier(tid);
+            const double tt_sum = partial.sum(SLOT_TT);
+            omega = tt_sum > 0.0 ? partial.sum(SLOT_TS) / tt_sum : 0.0;
+
+            // x += alpha p + omega s, r = s - omega t, fused with r . r and
+            // r_hat . r (rho of the next iteration)
+            double rr_local = 0.0, rhat_r = 0.0;
+            for (int i = r0; i < r1; ++i) {
+                x[i] += alpha * p[i] + omega * s[i];
+                r[i]  = s[i] - omega * t[i];
+                rr_local += r[i] * r[i];
+                rhat_r   += r_hat[i] * r[i];
+            }
+            partial.at(tid, SLOT_RR)     = rr_local;
+            partial.at(tid, SLOT_RHAT_R) = rhat_r;
+            team.barrier(tid);
+            rr      = partial.sum(SLOT_RR);
+            rho_old = rho;
+            rho     = partial.sum(SLOT_RHAT_R);
+            breakdown = (rho == 0.0 || omega == 0.0 || !std::isfinite(rr));
+            ++it;
+
+            if (tid == 0) result.history.push_back(std::sqrt(rr) * scale);
+        }
+
+        if (tid == 0) {
+            result.iterations = it;
+            result.residual   = std::sqrt(rr) * scale;
+            result.converged  = result.residual <= tol;
+            result.breakdown  = breakdown;
+        }
+    });
+}
+
+// Both solvers on an OpenMP parallel region.
+inline void cg_solve(const CsrMatrix& A, const RowPartition& part,
+                     const std::vector<double>& b, std::vector<double>& x,
+                     double tol, int maxit, KrylovResult& result) {
+    OmpTeam team(part.nparts);
+    cg_solve(team, A, part, b, x, tol, maxit, result);
+}
+
+inline void bicgstab_solve(const CsrMatrix& A, const RowPartition& part,
+                           const std::vector<double>& b, std::vector<double>& x,
+                           double tol, int maxit, KrylovResult& result) {
+    OmpTeam team(part.nparts);
+    bicgstab_solve(team, A, part, b, x, tol, maxit, result);
+}
+
+#endif // KRYLOV_H
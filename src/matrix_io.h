@@ -0,0 +1,840 @@
+#ifndef MATRIX_IO_H
+#define MATRIX_IO_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// Matrix Market reader
+// ---------------------------------------------------------------------------
+//
+// The file is mmap'ed and never copied: the body is split into
+// newline-aligned chunks that are parsed in parallel with a hand-written
+// integer/double fast path. A first pass over the chunks counts entries
+// (per chunk, or per row when building CSR directly), so the second pass
+// knows where every entry goes and can write it straight into its slot.
+
+inline bool mtx_is_blank(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+inline const char* mtx_skip_blanks(const char* p, const char* end) {
+    while (p < end && mtx_is_blank(*p)) ++p;
+    return p;
+}
+
+inline const char* mtx_next_line(const char* p, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return nl ? nl + 1 : end;
+}
+
+// True if the line starting at p carries an entry (not blank, not a comment).
+inline bool mtx_is_data_line(const char* p, const char* end) {
+    p = mtx_skip_blanks(p, end);
+    return p < end && *p != '\n' && *p != '%';
+}
+
+// Parse an unsigned decimal integer.
+inline bool mtx_parse_int(const char*& p, const char* end, long long& out) {
+    p = mtx_skip_blanks(p, end);
+    const char* start = p;
+    long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p - '0');
+        ++p;
+    }
+    out = v;
+    return p != start && p - start <= 18;
+}
+
+// Parse a floating point number. Values with at most 19 significant digits
+// and a small decimal exponent are assembled exactly from an integer
+// mantissa and a power of ten (Clinger's fast path, correctly rounded);
+// anything else (long mantissas, huge exponents, inf/nan) goes to strtod.
+inline bool mtx_parse_double(const char*& p, const char* end, double& out) {
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    p = mtx_skip_blanks(p, end);
+    const char* start = p;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits   = 0;   // significant digits accumulated in mantissa
+    int exponent = 0;   // decimal exponent applied to mantissa
+    bool any_digit = false;
+    bool exact = true;
+
+    while (p < end && *p >= '0' && *p <= '9') {
+        any_digit = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0) ++digits;
+        } else {
+            ++exponent;
+            exact = false;
+        }
+        ++p;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            any_digit = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0) ++digits;
+                --exponent;
+            } else {
+                exact = false;
+            }
+            ++p;
+        }
+    }
+    if (any_digit && p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool exp_negative = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            exp_negative = (*q == '-');
+            ++q;
+        }
+        if (q < end && *q >= '0' && *q <= '9') {
+            int e = 0;
+            while (q < end && *q >= '0' && *q <= '9') {
+                if (e < 100000) e = e * 10 + (*q - '0');
+                ++q;
+            }
+            exponent += exp_negative ? -e : e;
+            p = q;
+        }
+    }
+
+    const bool delimited = (p == end || mtx_is_blank(*p) || *p == '\n');
+    if (any_digit && delimited && exact &&
+        mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        double v = static_cast<double>(mantissa);
+        v = (exponent < 0) ? v / pow10[-exponent] : v * pow10[exponent];
+        out = negative ? -v : v;
+        return true;
+    }
+
+    // Slow path: hand a bounded, NUL-terminated copy of the token to strtod
+    // (the mapping itself is not NUL-terminated).
+    p = start;
+    while (p < end && !mtx_is_blank(*p) && *p != '\n') ++p;
+    std::string token(start, p);
+    if (token.empty()) return false;
+    char* token_end = nullptr;
+    out = std::strtod(token.c_str(), &token_end);
+    return token_end == token.c_str() + token.size();
+}
+
+// Read-only mapping of a whole file.
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) return false;
+        data = static_cast<const char*>(map);
+        size = st.st_size;
+        madvise(map, size, MADV_SEQUENTIAL | MADV_WILLNEED);
+        return true;
+    }
+
+    ~MappedFile() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+};
+
+// Symmetry declared in the %%MatrixMarket banner. Symmetric and
+// skew-symmetric files store one triangle only; the reader normalises every
+// entry to the lower triangle (row >= col).
+enum MtxSymmetry {
+    MTX_GENERAL        = 0,
+    MTX_SYMMETRIC      = 1,
+    MTX_SKEW_SYMMETRIC = 2
+};
+
+struct MtxHeader {
+    long long rows = 0;
+    long long cols = 0;
+    long long nnz  = 0;
+    bool pattern = false;                 // no value column, entries are 1.0
+    MtxSymmetry symmetry = MTX_GENERAL;
+};
+
+// Parsed banner/size line and the newline-aligned chunks of the body.
+struct MtxBody {
+    MtxHeader header;
+    std::vector<const char*> chunk_begin;   // nchunks + 1 boundaries
+
+    int num_chunks() const { return static_cast<int>(chunk_begin.size()) - 1; }
+};
+
+// Parse "%%MatrixMarket matrix coordinate <field> <symmetry>". Files without
+// a banner are read as "coordinate real general".
+inline bool mtx_parse_banner(const std::string& filename, const char* p,
+                             const char* end, MtxHeader& header) {
+    const std::string banner = "%%MatrixMarket";
+    const char* nl = mtx_next_line(p, end);
+    std::string line(p, nl);
+    if (line.compare(0, banner.size(), banner) != 0) return true;
+
+    for (size_t i = 0; i < line.size(); ++i) {
+        line[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(line[i])));
+    }
+    std::istringstream ss(line.substr(banner.size()));
+    std::string object, format, field, symmetry;
+    ss >> object >> format >> field >> symmetry;
+
+    if (object != "matrix" || format != "coordinate") {
+        std::cerr << "Error: " << filename << ": only 'matrix coordinate' "
+                  << "Matrix Market files are supported.\n";
+        return false;
+    }
+
+    if (field == "real" || field == "double" || field == "integer") {
+        header.pattern = false;
+    } else if (field == "pattern") {
+        header.pattern = true;
+    } else {
+        std::cerr << "Error: " << filename << ": unsupported field '" << field
+                  << "' (use real, integer or pattern).\n";
+        return false;
+    }
+
+    if (symmetry == "general") {
+        header.symmetry = MTX_GENERAL;
+    } else if (symmetry == "symmetric" || symmetry == "hermitian") {
+        // Hermitian with a real field is plain symmetric
+        header.symmetry = MTX_SYMMETRIC;
+    } else if (symmetry == "skew-symmetric") {
+        header.symmetry = MTX_SKEW_SYMMETRIC;
+    } else {
+        std::cerr << "Error: " << filename << ": unsupported symmetry '"
+                  << symmetry << "'.\n";
+        return false;
+    }
+    return true;
+}
+
+inline bool mtx_split_body(const std::string& filename, const MappedFile& file,
+                           MtxBody& body) {
+    const char* p   = file.data;
+    const char* end = file.data + file.size;
+    MtxHeader& header = body.header;
+
+    if (!mtx_parse_banner(filename, p, end, header)) return false;
+
+    // Skip comments starting with '%' (and blank lines) up to the size line
+    while (p < end && !mtx_is_data_line(p, end)) p = mtx_next_line(p, end);
+
+    if (!mtx_parse_int(p, end, header.rows) ||
+        !mtx_parse_int(p, end, header.cols) ||
+        !mtx_parse_int(p, end, header.nnz)) {
+        std::cerr << "Error: invalid Matrix Market size line in " << filename << "\n";
+        return false;
+    }
+    p = mtx_next_line(p, end);
+
+    if (header.symmetry != MTX_GENERAL && header.rows != header.cols) {
+        std::cerr << "Error: " << filename << ": symmetric matrix is not square.\n";
+        return false;
+    }
+
+    // Split the body into newline-aligned chunks, several per thread so
+    // that uneven line lengths still balance out.
+    const size_t size      = end - p;
+    const size_t min_chunk = size_t(1) << 20;
+    int nchunks = std::max(1, io_num_threads() * 4);
+    if (size / nchunks < min_chunk) {
+        nchunks = static_cast<int>(std::max<size_t>(1, size / min_chunk));
+    }
+
+    body.chunk_begin.resize(nchunks + 1);
+    body.chunk_begin[0]       = p;
+    body.chunk_begin[nchunks] = end;
+    for (int k = 1; k < nchunks; ++k) {
+        const char* guess = p + size / nchunks * k;
+        body.chunk_begin[k] = std::max(body.chunk_begin[k - 1], mtx_next_line(guess - 1, end));
+    }
+    return true;
+}
+
+// Parse the two indices of an entry line (0-based, normalised to the lower
+// triangle for symmetric files). Returns false on malformed/out-of-range
+// indices.
+template <typename I>
+inline bool mtx_parse_indices(const char*& p, const char* end, const MtxHeader& header,
+                              I& row, I& col, bool& swapped) {
+    long long r, c;
+    if (!mtx_parse_int(p, end, r) || !mtx_parse_int(p, end, c) ||
+        r < 1 || r > header.rows || c < 1 || c > header.cols) {
+        return false;
+    }
+    swapped = (header.symmetry != MTX_GENERAL && c > r);
+    if (swapped) std::swap(r, c);
+
+    // Convert from 1-based (MatrixMarket) to 0-based indices
+    row = static_cast<I>(r - 1);
+    col = static_cast<I>(c - 1);
+    return true;
+}
+
+// Parse one entry line.
+template <typename I>
+inline bool mtx_parse_entry(const char* p, const char* end, const MtxHeader& header,
+                            I& row, I& col, double& val) {
+    bool swapped;
+    if (!mtx_parse_indices(p, end, header, row, col, swapped)) return false;
+
+    if (header.pattern) {
+        val = 1.0;
+    } else if (!mtx_parse_double(p, end, val)) {
+        return false;
+    }
+    // Upper-triangle entry of a skew-symmetric file: a_ji = -a_ij
+    if (swapped && header.symmetry == MTX_SKEW_SYMMETRIC) val = -val;
+    return true;
+}
+
+inline bool mtx_check_count(const MtxBody& body, long long found) {
+    if (found != body.header.nnz) {
+        std::cerr << "Error reading matrix data: header announces " << body.header.nnz
+                  << " entries, file holds " << found << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// Banner and size line of a Matrix Market file, without reading the body.
+inline bool read_matrix_market_header(const std::string& filename, MtxHeader& header) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "Error: could not open file " << filename << "\n";
+        return false;
+    }
+    MtxBody body;
+    if (!mtx_split_body(filename, file, body)) return false;
+    header = body.header;
+    return true;
+}
+
+// True (after printing an error) if the matrix of header does not fit the
+// offset / index types P / I.
+template <typename P, typename I>
+inline bool mtx_too_large(const std::string& filename, const MtxHeader& header,
+                          long long entries) {
+    if (header.rows >= (long long)std::numeric_limits<I>::max() ||
+        header.cols >= (long long)std::numeric_limits<I>::max() ||
+        entries > (long long)std::numeric_limits<P>::max()) {
+        std::cerr << "Error: " << filename << " (" << header.rows << " x " << header.cols
+                  << ", " << entries << " entries) does not fit " << 8 * sizeof(P)
+                  << "-bit offsets and " << 8 * sizeof(I) << "-bit column indices.\n";
+        return true;
+    }
+    return false;
+}
+
+// Parse a Matrix Market coordinate file into 0-based triplets (file order).
+// Symmetric files yield their stored (lower) triangle only.
+inline bool read_matrix_market_triplets(const std::string& filename,
+                                        MtxHeader& header,
+                                        std::vector<Triplet>& triplets) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "Error: could not open file " << filename << "\n";
+        return false;
+    }
+    MtxBody body;
+    if (!mtx_split_body(filename, file, body)) return false;
+    header = body.header;
+
+    const int nchunks = body.num_chunks();
+    const std::vector<const char*>& chunk_begin = body.chunk_begin;
+
+    // Pass 1: count data lines per chunk
+    std::vector<long long> chunk_offset(nchunks + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(io_num_threads())
+    for (int k = 0; k < nchunks; ++k) {
+        long long count = 0;
+        for (const char* q = chunk_begin[k]; q < chunk_begin[k + 1];
+             q = mtx_next_line(q, chunk_begin[k + 1])) {
+            if (mtx_is_data_line(q, chunk_begin[k + 1])) ++count;
+        }
+        chunk_offset[k + 1] = count;
+    }
+    for (int k = 0; k < nchunks; ++k) chunk_offset[k + 1] += chunk_offset[k];
+
+    if (!mtx_check_count(body, chunk_offset[nchunks])) return false;
+
+    // Pass 2: parse every chunk into its slice of the triplet array
+    triplets.resize(header.nnz);
+    int failed = 0;
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(io_num_threads()) reduction(|:failed)
+    for (int k = 0; k < nchunks; ++k) {
+        const char* chunk_end = chunk_begin[k + 1];
+        Triplet* out = triplets.data() + chunk_offset[k];
+        for (const char* q = chunk_begin[k]; q < chunk_end && !failed;
+             q = mtx_next_line(q, chunk_end)) {
+            if (!mtx_is_data_line(q, chunk_end)) continue;
+            if (!mtx_parse_entry(q, chunk_end, header, out->row, out->col, out->val)) {
+                failed = 1;
+                break;
+            }
+            ++out;
+        }
+    }
+    if (failed) {
+        std::cerr << "Error reading matrix data.\n";
+        return false;
+    }
+    return true;
+}
+
+// Read a Matrix Market coordinate file straight into CSR, without an
+// intermediate triplet array: pass 1 histograms the row index of every
+// line, the counts are prefix-summed into row_ptr, and pass 2 parses the
+// full lines and scatters column/value into the next free slot of their
+// row. Peak memory is the CSR arrays plus one cursor per row.
+//
+// The matrix is returned as stored in the file: for symmetric files csr
+// holds the lower triangle and symmetry tells the caller how to expand it.
+template <typename P, typename I>
+inline bool read_matrix_market(const std::string& filename, BasicCsrMatrix<double, P, I>& csr,
+                               MtxSymmetry& symmetry) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "Error: could not open file " << filename << "\n";
+        return false;
+    }
+    MtxBody body;
+    if (!mtx_split_body(filename, file, body)) return false;
+
+    const MtxHeader& header = body.header;
+    const int nchunks = body.num_chunks();
+    const std::vector<const char*>& chunk_begin = body.chunk_begin;
+
+    if (mtx_too_large<P, I>(filename, header, header.nnz)) return false;
+
+    symmetry = header.symmetry;
+    csr.rows = static_cast<I>(header.rows);
+    csr.cols = static_cast<I>(header.cols);
+    csr.nnz  = static_cast<P>(header.nnz);
+    csr.symmetric = false;
+    csr.row_ptr.assign(csr.rows + 1, 0);
+
+    // Pass 1: per-row entry counts (only the indices are parsed)
+    P* row_ptr = csr.row_ptr.data();
+    long long found = 0;
+    int failed = 0;
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(io_num_threads()) \
+        reduction(+:found) reduction(|:failed)
+    for (int k = 0; k < nchunks; ++k) {
+        const char* chunk_end = chunk_begin[k + 1];
+        for (const char* q = chunk_begin[k]; q < chunk_end;
+             q = mtx_next_line(q, chunk_end)) {
+            if (!mtx_is_data_line(q, chunk_end)) continue;
+            I r, c;
+            bool swapped;
+            const char* s = q;
+            if (!mtx_parse_indices(s, chunk_end, header, r, c, swapped)) {
+                failed = 1;
+                break;
+            }
+            #pragma omp atomic
+            row_ptr[r + 1]++;
+            ++found;
+        }
+    }
+    if (failed) {
+        std::cerr << "Error reading matrix data.\n";
+        return false;
+    }
+    if (!mtx_check_count(body, found)) return false;
+
+    csr_prefix_sum(csr.row_ptr);
+    csr.col_ind.resize(csr.nnz);
+    csr.values.resize(csr.nnz);
+
+    // Pass 2: parse and scatter into the next free slot of each row
+    std::vector<P> cursor(csr.row_ptr.begin(), csr.row_ptr.end() - 1);
+    P* next        = cursor.data();
+    I* col_ind     = csr.col_ind.data();
+    double* values = csr.values.data();
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(io_num_threads()) reduction(|:failed)
+    for (int k = 0; k < nchunks; ++k) {
+        const char* chunk_end = chunk_begin[k + 1];
+        for (const char* q = chunk_begin[k]; q < chunk_end;
+             q = mtx_next_line(q, chunk_end)) {
+            if (!mtx_is_data_line(q, chunk_end)) continue;
+            I r, c;
+            double v;
+            if (!mtx_parse_entry(q, chunk_end, header, r, c, v)) {
+                failed = 1;
+                break;
+            }
+            P slot;
+            #pragma omp atomic capture
+            slot = next[r]++;
+            col_ind[slot] = c;
+            values[slot]  = v;
+        }
+    }
+    if (failed) {
+        std::cerr << "Error reading matrix data.\n";
+        return false;
+    }
+
+    csr_sort_rows(csr);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Binary CSR cache
+// ---------------------------------------------------------------------------
+//
+// Layout of a "<name>.csr" file (native endianness):
+//
+//   CsrFileHeader                         (64 bytes)
+//   P      row_ptr[rows + 1]              (padded to a 64-byte boundary)
+//   I      col_ind[nnz]                   (padded to a 64-byte boundary)
+//   double values[nnz]
+//
+// P and I are the offset and index types of the matrix (4 or 8 bytes, see
+// csr_index_width), recorded in the header; a cache written with other
+// widths is rebuilt like a stale one.
+//
+// The header records size and mtime of the .mtx it was built from, so a
+// stale cache is detected and rebuilt automatically. The arrays hold the
+// matrix as stored in the file (one triangle for symmetric matrices, with
+// the MtxSymmetry in flags), so one cache serves every symmetric mode.
+
+static const char CSR_FILE_MAGIC[8] = {'S', 'P', 'M', 'V', 'C', 'S', 'R', '\0'};
+static const uint32_t CSR_FILE_VERSION = 3;
+static const uint64_t CSR_FILE_ALIGN   = 64;
+
+struct CsrFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;          // MtxSymmetry of the stored triangle
+    int64_t  rows;
+    int64_t  cols;
+    int64_t  nnz;
+    uint64_t source_size;    // st_size of the source .mtx
+    int64_t  source_mtime;   // st_mtime of the source .mtx
+    uint32_t offset_bytes;   // sizeof(row_ptr[0])
+    uint32_t index_bytes;    // sizeof(col_ind[0])
+};
+
+static_assert(sizeof(CsrFileHeader) == 64, "CsrFileHeader must be 64 bytes");
+
+inline uint64_t csr_file_align(uint64_t offset) {
+    return (offset + CSR_FILE_ALIGN - 1) / CSR_FILE_ALIGN * CSR_FILE_ALIGN;
+}
+
+// Byte offsets of the three arrays inside a cache file.
+struct CsrFileLayout {
+    uint64_t row_ptr_offset;
+    uint64_t col_ind_offset;
+    uint64_t values_offset;
+    uint64_t total_size;
+};
+
+inline CsrFileLayout csr_file_layout(int64_t rows, int64_t nnz, uint64_t offset_bytes,
+                                     uint64_t index_bytes) {
+    CsrFileLayout l;
+    l.row_ptr_offset = csr_file_align(sizeof(CsrFileHeader));
+    l.col_ind_offset = csr_file_align(l.row_ptr_offset + (rows + 1) * offset_bytes);
+    l.values_offset  = csr_file_align(l.col_ind_offset + nnz * index_bytes);
+    l.total_size     = l.values_offset + nnz * sizeof(double);
+    return l;
+}
+
+// Example: "/home/.../cage14/cage14.mtx" -> "/home/.../cage14/cage14.csr"
+inline std::string csr_cache_path(const std::string& mtx_path) {
+    const std::string ext = ".mtx";
+    std::string base = mtx_path;
+    if (base.size() > ext.size() &&
+        base.compare(base.size() - ext.size(), ext.size(), ext) == 0) {
+        base.erase(base.size() - ext.size(), ext.size());
+    }
+    return base + ".csr";
+}
+
+// True if h is a cache header of the current format, built from source and
+// consistent with a cache file of file_size bytes; l is its array layout.
+inline bool csr_cache_header_valid(const CsrFileHeader& h, const struct stat& source,
+                                   uint64_t file_size, CsrFileLayout& l) {
+    const bool ok = std::memcmp(h.magic, CSR_FILE_MAGIC, sizeof(h.magic)) == 0 &&
+                    h.version == CSR_FILE_VERSION &&
+                    h.source_size == (uint64_t)source.st_size &&
+                    h.source_mtime == (int64_t)source.st_mtime &&
+                    h.flags <= MTX_SKEW_SYMMETRIC &&
+                    (h.offset_bytes == 4 || h.offset_bytes == 8) &&
+                    (h.index_bytes == 4 || h.index_bytes == 8) &&
+                    h.rows >= 0 && h.cols >= 0 && h.nnz >= 0;
+    if (!ok) return false;
+    l = csr_file_layout(h.rows, h.nnz, h.offset_bytes, h.index_bytes);
+    return l.total_size == file_size;
+}
+
+// Read and check only the header of a cache file (silently false if it is
+// missing or does not match the source .mtx).
+inline bool read_csr_cache_header(const std::string& cache_path, const struct stat& source,
+                                  CsrFileHeader& h, CsrFileLayout& l) {
+    int fd = open(cache_path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    const bool ok = fstat(fd, &st) == 0 &&
+                    pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+                    csr_cache_header_valid(h, source, st.st_size, l);
+    close(fd);
+    return ok;
+}
+
+// Map a cache file and copy its arrays into csr. Returns false (silently)
+// if the file is missing, malformed or does not match the source .mtx.
+template <typename P, typename I>
+inline bool read_csr_cache(const std::string& cache_path,
+                           const struct stat& source, BasicCsrMatrix<double, P, I>& csr,
+                           MtxSymmetry& symmetry) {
+    int fd = open(cache_path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CsrFileHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    const char* base = static_cast<const char*>(map);
+    CsrFileHeader h;
+    std::memcpy(&h, base, sizeof(h));
+
+    CsrFileLayout l;
+    const bool ok = csr_cache_header_valid(h, source, st.st_size, l) &&
+                    h.offset_bytes == sizeof(P) && h.index_bytes == sizeof(I);
+
+    if (ok) {
+        // The advice values are an enumeration, not flags: they cannot be
+        // or-ed together.
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        madvise(map, st.st_size, MADV_WILLNEED);
+
+        symmetry = static_cast<MtxSymmetry>(h.flags);
+        csr.rows = (I)h.rows;
+        csr.cols = (I)h.cols;
+        csr.nnz  = (P)h.nnz;
+        csr.symmetric = false;
+
+        // The arrays are copied out rather than used in place: the matrix
+        // owns its storage as std::vector (kernels, reordering and the NUMA
+        // first touch all resize, permute or release it), and a private
+        // file mapping would keep the pages on whichever node read them.
+        // The copy is split into row blocks, one per thread, with each
+        // block's entries following its rows.
+        csr.row_ptr.resize(h.rows + 1);
+        csr.col_ind.resize(h.nnz);
+        csr.values.resize(h.nnz);
+        const P* file_row_ptr  = reinterpret_cast<const P*>(base + l.row_ptr_offset);
+        const I* file_col_ind  = reinterpret_cast<const I*>(base + l.col_ind_offset);
+        const double* file_values = reinterpret_cast<const double*>(base + l.values_offset);
+
+        // Block boundaries in rows and entries. The entry boundaries come
+        // from the file's row_ptr, clamped so that a damaged file still
+        // covers [0, nnz) exactly once.
+        const int nblocks = std::max(1, io_num_threads());
+        std::vector<long long> block_row(nblocks + 1), block_nz(nblocks + 1);
+        for (int k = 0; k <= nblocks; ++k) {
+            block_row[k] = h.rows * k / nblocks;
+            const long long nz = k == 0 ? 0 : k == nblocks ? h.nnz
+                                                           : (long long)file_row_ptr[block_row[k]];
+            block_nz[k] = k == 0 ? 0 : std::min(std::max(nz, block_nz[k - 1]), (long long)h.nnz);
+        }
+
+        P* row_ptr     = csr.row_ptr.data();
+        I* col_ind     = csr.col_ind.data();
+        double* values = csr.values.data();
+        #pragma omp parallel for schedule(static, 1) num_threads(nblocks)
+        for (int k = 0; k < nblocks; ++k) {
+            const long long r0 = block_row[k];
+            const long long r1 = block_row[k + 1] + (k + 1 == nblocks ? 1 : 0);
+            const long long j0 = block_nz[k], j1 = block_nz[k + 1];
+            std::memcpy(row_ptr + r0, file_row_ptr + r0, (r1 - r0) * sizeof(P));
+            std::memcpy(col_ind + j0, file_col_ind + j0, (j1 - j0) * sizeof(I));
+            std::memcpy(values + j0, file_values + j0, (j1 - j0) * sizeof(double));
+        }
+    }
+
+    munmap(map, st.st_size);
+    return ok;
+}
+
+// Write csr to cache_path. The file is written under a temporary name and
+// renamed into place, so concurrent jobs never observe a partial cache.
+template <typename P, typename I>
+inline bool write_csr_cache(const std::string& cache_path,
+                            const struct stat& source, const BasicCsrMatrix<double, P, I>& csr,
+                            MtxSymmetry symmetry) {
+    CsrFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, CSR_FILE_MAGIC, sizeof(h.magic));
+    h.version      = CSR_FILE_VERSION;
+    h.flags        = symmetry;
+    h.rows         = csr.rows;
+    h.cols         = csr.cols;
+    h.nnz          = csr.nnz;
+    h.source_size  = source.st_size;
+    h.source_mtime = source.st_mtime;
+    h.offset_bytes = sizeof(P);
+    h.index_bytes  = sizeof(I);
+
+    const CsrFileLayout l = csr_file_layout(h.rows, h.nnz, sizeof(P), sizeof(I));
+    const std::string tmp_path = cache_path + ".tmp." + std::to_string(getpid());
+
+    FILE* f = std::fopen(tmp_path.c_str(), "wb");
+    if (!f) return false;
+
+    static const char zeros[CSR_FILE_ALIGN] = {0};
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+
+    ok = ok && std::fwrite(zeros, 1, l.row_ptr_offset - sizeof(h), f) ==
+                   l.row_ptr_offset - sizeof(h);
+    ok = ok && std::fwrite(csr.row_ptr.data(), sizeof(P), h.rows + 1, f) ==
+                   (size_t)(h.rows + 1);
+
+    uint64_t pad = l.col_ind_offset - (l.row_ptr_offset + (h.rows + 1) * sizeof(P));
+    ok = ok && std::fwrite(zeros, 1, pad, f) == pad;
+    ok = ok && std::fwrite(csr.col_ind.data(), sizeof(I), h.nnz, f) ==
+                   (size_t)h.nnz;
+
+    pad = l.values_offset - (l.col_ind_offset + h.nnz * sizeof(I));
+    ok = ok && std::fwrite(zeros, 1, pad, f) == pad;
+    ok = ok && std::fwrite(csr.values.data(), sizeof(double), h.nnz, f) ==
+                   (size_t)h.nnz;
+
+    ok = (std::fclose(f) == 0) && ok;
+    ok = ok && std::rename(tmp_path.c_str(), cache_path.c_str()) == 0;
+    if (!ok) std::remove(tmp_path.c_str());
+    return ok;
+}
+
+// How to hold a matrix whose file stores one triangle of a symmetric matrix.
+enum SymmetricStorage {
+    SYM_EXPAND,   // mirror the stored triangle into a full CSR matrix
+    SYM_HALF      // keep the lower triangle, csr.symmetric = true
+};
+
+// The matrix as stored in the file (one triangle for symmetric files),
+// going through the binary cache next to the .mtx file. On the first run the
+// .mtx is parsed and the cache is written; later runs only map the cache and
+// skip parsing and sorting entirely.
+template <typename P, typename I>
+inline bool load_matrix_stored(const std::string& filename, BasicCsrMatrix<double, P, I>& csr,
+                               MtxSymmetry& symmetry) {
+    struct stat source;
+    if (stat(filename.c_str(), &source) != 0) {
+        std::cerr << "Error: could not open file " << filename << "\n";
+        return false;
+    }
+
+    const std::string cache_path = csr_cache_path(filename);
+    symmetry = MTX_GENERAL;
+    if (!read_csr_cache(cache_path, source, csr, symmetry)) {
+        if (!read_matrix_market(filename, csr, symmetry)) return false;
+
+        // A missing cache only costs time, so a failed write is not fatal.
+        if (!write_csr_cache(cache_path, source, csr, symmetry)) {
+            std::cerr << "Warning: could not write CSR cache " << cache_path << "\n";
+        }
+    }
+    return true;
+}
+
+// Load a matrix through the cache (load_matrix_stored). General matrices
+// are returned as they are. Symmetric matrices are expanded or kept in half
+// storage depending on storage; skew-symmetric matrices are always expanded.
+template <typename P, typename I>
+inline bool load_matrix(const std::string& filename, BasicCsrMatrix<double, P, I>& csr,
+                        SymmetricStorage storage = SYM_EXPAND) {
+    MtxSymmetry symmetry = MTX_GENERAL;
+    if (!load_matrix_stored(filename, csr, symmetry)) return false;
+
+    if (symmetry == MTX_SYMMETRIC && storage == SYM_HALF) {
+        csr.symmetric = true;
+    } else if (symmetry != MTX_GENERAL) {
+        // The expansion doubles every off-diagonal entry
+        long long diagonal = 0;
+        #pragma omp parallel for schedule(static) num_threads(io_num_threads()) \
+            reduction(+:diagonal)
+        for (I i = 0; i < csr.rows; ++i) {
+            for (P j = csr.row_ptr[i]; j < csr.row_ptr[i + 1]; ++j) {
+                if (csr.col_ind[j] == i) ++diagonal;
+            }
+        }
+        MtxHeader header;
+        header.rows = csr.rows;
+        header.cols = csr.cols;
+        if (mtx_too_large<P, I>(filename, header, 2 * (long long)csr.nnz - diagonal)) return false;
+
+        BasicCsrMatrix<double, P, I> full;
+        csr_expand_symmetric(csr, symmetry == MTX_SKEW_SYMMETRIC ? -1.0 : 1.0, full);
+        std::swap(csr, full);
+    }
+    return true;
+}
+
+// Index width load_matrix needs for filename with the given storage, from
+// the header alone: symmetric files are assumed to double their entries when
+// expanded, so the choice can be one size too wide but never too narrow.
+inline bool matrix_index_width(const std::string& filename, SymmetricStorage storage,
+                               CsrIndexWidth& width) {
+    MtxHeader header;
+    if (!read_matrix_market_header(filename, header)) return false;
+    const bool expand = header.symmetry == MTX_SKEW_SYMMETRIC ||
+                        (header.symmetry == MTX_SYMMETRIC && storage == SYM_EXPAND);
+    width = csr_index_width(header.rows, header.cols, expand ? 2 * header.nnz : header.nnz);
+    return true;
+}
+
+#endif // MATRIX_IO_H
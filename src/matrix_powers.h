@@ -0,0 +1,253 @@
+#ifndef MATRIX_POWERS_H
+#define MATRIX_POWERS_H
+
+#include <vector>
+#include <algorithm>
+
+#include "csr_matrix.h"
+#include "csr_kernels.h"
+
+// ---------------------------------------------------------------------------
+// Matrix powers kernel: x_1 ... x_k with x_p = A x_{p-1} (x_0 = x)
+// ---------------------------------------------------------------------------
+//
+// A chain of k SpMV calls streams the whole matrix k times and ends every
+// power at a barrier. Here the rows are cut into tiles whose nonzeros fit a
+// cache budget, and each tile computes all k powers of its own rows before
+// the next tile starts, so its values / col_ind are read from memory once
+// and from cache for the other k - 1 powers. Tiles run in parallel and
+// independently: there is no barrier between the powers.
+//
+// Power p of a row needs power p - 1 of the rows its columns point to. The
+// plan finds these dependencies level by level, backwards from the tile:
+//
+//   L_k     = the tile's own rows
+//   L_{p-1} = L_p + the columns of the rows of L_p
+//
+// and the tile computes power p on every row of L_p: the rows outside the
+// tile (ghost rows) are computed redundantly instead of being exchanged. The
+// rows of a tile are renumbered locally in level order (own rows first,
+// then the ghosts added by each level), so L_p is the prefix of
+// level_end[p] local rows and power p is one sweep over a local CSR prefix.
+// x_0 is gathered from x on the L_0 rows once per tile.
+//
+// The ghost rows cost extra flops, which grow with the reach of the matrix
+// (a banded matrix, e.g. after --reorder rcm, adds about one bandwidth per
+// level and tile side). When they would more than double the work the plan
+// is marked as fallback and spmv_matrix_powers runs the plain chain.
+//
+// A three-term recurrence
+//
+//   x_p = alpha_p A x_{p-1} + beta_p x_{p-1} + gamma_p x_{p-2}
+//
+// covers the shifted (Newton) and Chebyshev bases as well as the monomial
+// one; the plan starts with the monomial basis (alpha 1, beta = gamma = 0).
+
+// Ghost nonzeros allowed per useful nonzero before falling back to the chain
+static const double MATRIX_POWERS_MAX_OVERHEAD = 1.0;
+
+// Default cache budget of a tile (own nonzeros; KB)
+static const int MATRIX_POWERS_TILE_KB = 512;
+
+struct MatrixPowersTile {
+    int row_begin = 0;               // own rows [row_begin, row_end)
+    int row_end   = 0;
+    std::vector<int> rows;           // local row -> global row, in level order
+    std::vector<int> level_end;      // k + 1 prefix lengths: rows of L_p
+    std::vector<int> row_ptr;        // local CSR of the rows of L_1
+    std::vector<int> col_ind;        // local row numbers
+    std::vector<double> values;
+};
+
+struct MatrixPowersPlan {
+    int k = 0;
+    int nthreads = 0;
+    int tile_kb = 0;
+    bool fallback = false;
+    long long nnz = 0;
+    long long computed_nnz = 0;      // nonzeros multiplied per call, ghosts included
+    std::vector<MatrixPowersTile> tiles;
+    std::vector<double> alpha, beta, gamma;   // coefficients of power p at p - 1
+    size_t work_stride = 0;          // largest local row count of a tile
+    std::vector<double> work;        // per thread: k + 1 local vectors
+
+    // Redundant nonzeros per useful one (0: no ghost rows)
+    double overhead() const {
+        return nnz > 0 ? (double)computed_nnz / ((double)k * nnz) - 1.0 : 0.0;
+    }
+};
+
+// Optional recurrence of length k (default: monomial)
+inline void matrix_powers_set_recurrence(MatrixPowersPlan& plan, const std::vector<double>& alpha,
+                                         const std::vector<double>& beta,
+                                         const std::vector<double>& gamma) {
+    plan.alpha = alpha;
+    plan.beta  = beta;
+    plan.gamma = gamma;
+}
+
+// A must be square. A tile holds at most tile_kb KB of own nonzeros (12
+// bytes each) and at most nnz / nthreads of them, so every thread gets work.
+inline void build_matrix_powers_plan(const CsrMatrix& A, int k, int tile_kb, int nthreads,
+                                     MatrixPowersPlan& plan) {
+    const int* row_ptr   = A.row_ptr.data();
+    const int* col_ind   = A.col_ind.data();
+    const double* values = A.values.data();
+
+    plan = MatrixPowersPlan();
+    plan.k        = k;
+    plan.nthreads = nthreads;
+    plan.tile_kb  = tile_kb;
+    plan.nnz      = A.nnz;
+    plan.alpha.assign(k, 1.0);
+    plan.beta.assign(k, 0.0);
+    plan.gamma.assign(k, 0.0);
+
+    const long long budget = std::max(1LL, std::min<long long>(
+        (long long)tile_kb * 1024 / 12, ((long long)A.nnz + nthreads - 1) / nthreads));
+    const double limit = (1.0 + MATRIX_POWERS_MAX_OVERHEAD) * k * (double)A.nnz;
+
+    std::vector<int> local(A.rows, -1);
+    size_t max_local = 0;
+    for (int r0 = 0; r0 < A.rows;) {
+        int r1 = r0 + 1;
+        while (r1 < A.rows && row_ptr[r1] - row_ptr[r0] < budget) ++r1;
+
+        MatrixPowersTile tile;
+        tile.row_begin = r0;
+        tile.row_end   = r1;
+        for (int i = r0; i < r1; ++i) {
+            local[i] = (int)tile.rows.size();
+            tile.rows.push_back(i);
+        }
+
+        // Levels backwards from the tile: only the rows added last can
+        // point outside the level before
+        tile.level_end.assign(k + 1, 0);
+        tile.level_end[k] = r1 - r0;
+        size_t frontier = 0;
+        for (int p = k - 1; p >= 0; --p) {
+            const size_t end = tile.rows.size();
+            for (size_t r = frontier; r < end; ++r) {
+                const int i = tile.rows[r];
+                for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                    const int col = col_ind[j];
+                    if (local[col] < 0) {
+                        local[col] = (int)tile.rows.size();
+                        tile.rows.push_back(col);
+                    }
+                }
+            }
+            frontier = end;
+            tile.level_end[p] = (int)tile.rows.size();
+        }
+
+        // Local CSR of the rows power 1 is computed on
+        const int n1 = tile.level_end[1];
+        tile.row_ptr.resize(n1 + 1);
+        tile.row_ptr[0] = 0;
+        for (int r = 0; r < n1; ++r) {
+            const int i = tile.rows[r];
+            for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+                tile.col_ind.push_back(local[col_ind[j]]);
+                tile.values.push_back(values[j]);
+            }
+            tile.row_ptr[r + 1] = (int)tile.col_ind.size();
+        }
+        for (int p = 1; p <= k; ++p) plan.computed_nnz += tile.row_ptr[tile.level_end[p]];
+
+        for (size_t r = 0; r < tile.rows.size(); ++r) local[tile.rows[r]] = -1;
+        max_local = std::max(max_local, tile.rows.size());
+        plan.tiles.push_back(std::move(tile));
+
+        if (plan.computed_nnz > limit) {
+            plan.fallback = true;
+            plan.tiles.clear();
+            return;
+        }
+        r0 = r1;
+    }
+
+    plan.work_stride = max_local;
+    plan.work.assign((size_t)nthreads * (k + 1) * max_local, 0.0);
+}
+
+// The plain chain: k calls of spmv_csr_parallel (schedule(runtime)), with
+// the recurrence applied after each call when it is not monomial
+inline void matrix_powers_chain(const CsrMatrix& A, const MatrixPowersPlan& plan,
+                                const std::vector<double>& x,
+                                std::vector<std::vector<double> >& y) {
+    for (int p = 1; p <= plan.k; ++p) {
+        const std::vector<double>& prev = p > 1 ? y[p - 2] : x;
+        std::vector<double>& cur = y[p - 1];
+        spmv_csr_parallel(A, prev, cur);
+
+        const double a = plan.alpha[p - 1];
+        const double b = plan.beta[p - 1];
+        const double g = p > 1 ? plan.gamma[p - 1] : 0.0;
+        if (a == 1.0 && b == 0.0 && g == 0.0) continue;
+        const double* prev2 = p > 2 ? y[p - 3].data() : x.data();
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < A.rows; ++i) {
+            cur[i] = a * cur[i] + b * prev[i] + (g != 0.0 ? g * prev2[i] : 0.0);
+        }
+    }
+}
+
+// y[p - 1] = x_p for p = 1 ... k; every y[p - 1] must have A.rows entries
+inline void spmv_matrix_powers(const CsrMatrix& A, MatrixPowersPlan& plan,
+                               const std::vector<double>& x,
+                               std::vector<std::vector<double> >& y) {
+    if (plan.fallback) {
+        matrix_powers_chain(A, plan, x, y);
+        return;
+    }
+
+    const int k         = plan.k;
+    const int num_tiles = (int)plan.tiles.size();
+    const size_t stride = plan.work_stride;
+    const double* x_in  = x.data();
+
+    #pragma omp parallel num_threads(plan.nthreads)
+    {
+        double* work = plan.work.data() + (size_t)csr_kernel_thread() * (k + 1) * stride;
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int t = 0; t < num_tiles; ++t) {
+            const MatrixPowersTile& tile = plan.tiles[t];
+            const int* rows      = tile.rows.data();
+            const int* row_ptr   = tile.row_ptr.data();
+            const int* col_ind   = tile.col_ind.data();
+            const double* values = tile.values.data();
+
+            for (int r = 0; r < tile.level_end[0]; ++r) work[r] = x_in[rows[r]];
+
+            for (int p = 1; p <= k; ++p) {
+                const double* prev  = work + (size_t)(p - 1) * stride;
+                const double* prev2 = p > 1 ? work + (size_t)(p - 2) * stride : work;
+                double* cur         = work + (size_t)p * stride;
+                const double a = plan.alpha[p - 1];
+                const double b = plan.beta[p - 1];
+                const double g = p > 1 ? plan.gamma[p - 1] : 0.0;
+                const bool monomial = (a == 1.0 && b == 0.0 && g == 0.0);
+
+                for (int r = 0; r < tile.level_end[p]; ++r) {
+                    double sum = 0.0;
+                    for (int j = row_ptr[r]; j < row_ptr[r + 1]; ++j) {
+                        sum += values[j] * prev[col_ind[j]];
+                    }
+                    cur[r] = monomial ? sum : a * sum + b * prev[r] + g * prev2[r];
+                }
+            }
+
+            // The own rows are the first local rows, in order
+            const int own = tile.row_end - tile.row_begin;
+            for (int p = 1; p <= k; ++p) {
+                const double* cur = work + (size_t)p * stride;
+                std::copy(cur, cur + own, y[p - 1].begin() + tile.row_begin);
+            }
+        }
+    }
+}
+
+#endif // MATRIX_POWERS_H
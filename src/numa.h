@@ -0,0 +1,275 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// Thread binding
+// ---------------------------------------------------------------------------
+//
+// Every CPU the process may run on is described by its socket and core id
+// (from /sys/devices/system/cpu). Thread t of the OpenMP team is then pinned
+// with sched_setaffinity:
+//
+//   compact: consecutive physical cores of socket 0, then socket 1, ...
+//            (SMT siblings only after every core has one thread)
+//   scatter: round-robin over the sockets, compact inside each socket
+//   socket:  to all CPUs of one socket, contiguous blocks of threads per socket
+//
+// libgomp reuses the same OS threads for later teams of the same size, so
+// the binding holds for every kernel call.
+
+enum ThreadBinding {
+    BIND_NONE,
+    BIND_COMPACT,
+    BIND_SCATTER,
+    BIND_SOCKET
+};
+
+inline const char* thread_binding_name(ThreadBinding bind) {
+    switch (bind) {
+        case BIND_COMPACT: return "compact";
+        case BIND_SCATTER: return "scatter";
+        case BIND_SOCKET:  return "socket";
+        default:           return "none";
+    }
+}
+
+struct CpuInfo {
+    int cpu;
+    int socket;
+    int core;
+    int smt;      // rank among the SMT siblings of its core
+};
+
+inline int read_topology_id(int cpu, const char* name) {
+    char path[128];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE* f = std::fopen(path, "r");
+    if (!f) return 0;
+    int id = 0;
+    if (std::fscanf(f, "%d", &id) != 1) id = 0;
+    std::fclose(f);
+    return id;
+}
+
+// CPUs of the affinity mask of the calling thread.
+inline std::vector<int> current_cpu_set() {
+    std::vector<int> set;
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &mask)) set.push_back(cpu);
+        }
+    }
+#endif
+    return set;
+}
+
+// CPUs the process may run on: the mask of the first caller (the main
+// thread, before any binding), cached so that binding the main thread does
+// not shrink the set seen by later bindings.
+inline const std::vector<int>& process_cpu_set() {
+    static const std::vector<int> set = current_cpu_set();
+    return set;
+}
+
+// CPUs of the process affinity mask in compact order (socket, smt, core).
+inline std::vector<CpuInfo> available_cpus() {
+    std::vector<CpuInfo> cpus;
+#ifdef __linux__
+    const std::vector<int>& set = process_cpu_set();
+    for (size_t k = 0; k < set.size(); ++k) {
+        const int cpu = set[k];
+        CpuInfo info;
+        info.cpu    = cpu;
+        info.socket = read_topology_id(cpu, "physical_package_id");
+        info.core   = read_topology_id(cpu, "core_id");
+        info.smt    = 0;
+        cpus.push_back(info);
+    }
+    for (size_t a = 0; a < cpus.size(); ++a) {
+        for (size_t b = 0; b < a; ++b) {
+            if (cpus[b].socket == cpus[a].socket && cpus[b].core == cpus[a].core) ++cpus[a].smt;
+        }
+    }
+    std::sort(cpus.begin(), cpus.end(), [](const CpuInfo& x, const CpuInfo& y) {
+        if (x.socket != y.socket) return x.socket < y.socket;
+        if (x.smt != y.smt) return x.smt < y.smt;
+        if (x.core != y.core) return x.core < y.core;
+        return x.cpu < y.cpu;
+    });
+#endif
+    return cpus;
+}
+
+// CPU set of every thread; empty if the binding cannot be applied.
+inline std::vector<std::vector<int> > binding_cpu_sets(ThreadBinding bind, int nthreads) {
+    std::vector<std::vector<int> > sets;
+    const std::vector<CpuInfo> cpus = available_cpus();
+    if (bind == BIND_NONE || cpus.empty()) return sets;
+
+    // CPUs of every socket, in compact order
+    std::vector<std::vector<int> > sockets;
+    for (size_t k = 0; k < cpus.size(); ++k) {
+        if (k == 0 || cpus[k].socket != cpus[k - 1].socket) sockets.push_back(std::vector<int>());
+        sockets.back().push_back(cpus[k].cpu);
+    }
+    const int nsockets = static_cast<int>(sockets.size());
+
+    sets.resize(nthreads);
+    for (int t = 0; t < nthreads; ++t) {
+        if (bind == BIND_COMPACT) {
+            sets[t].push_back(cpus[t % cpus.size()].cpu);
+        } else if (bind == BIND_SCATTER) {
+            const std::vector<int>& s = sockets[t % nsockets];
+            sets[t].push_back(s[(t / nsockets) % s.size()]);
+        } else {
+            sets[t] = sockets[static_cast<int>((long long)t * nsockets / nthreads)];
+        }
+    }
+    return sets;
+}
+
+// Pin the calling thread to a CPU set.
+inline bool bind_current_thread(const std::vector<int>& set) {
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (size_t k = 0; k < set.size(); ++k) CPU_SET(set[k], &mask);
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+    (void)set;
+    return false;
+#endif
+}
+
+// Pin the threads of an OpenMP team of nthreads threads. Returns false
+// (and leaves the threads unbound) if the platform has no affinity support.
+inline bool bind_threads(ThreadBinding bind, int nthreads,
+                         std::vector<std::vector<int> >& sets) {
+    sets = binding_cpu_sets(bind, nthreads);
+    if (sets.empty()) return bind == BIND_NONE;
+#ifdef __linux__
+    bool ok = true;
+    #pragma omp parallel num_threads(nthreads) reduction(&&:ok)
+    {
+        int tid = 0;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+#endif
+        ok = bind_current_thread(sets[tid]);
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+// Undo bind_threads: the first nthreads OpenMP threads may again run on
+// every CPU of the process.
+inline void unbind_threads(int nthreads) {
+    const std::vector<int>& set = process_cpu_set();
+    if (set.empty()) return;
+    #pragma omp parallel num_threads(nthreads)
+    bind_current_thread(set);
+}
+
+// ---------------------------------------------------------------------------
+// First-touch placement
+// ---------------------------------------------------------------------------
+//
+// Linux places a page on the NUMA node of the thread that first writes it.
+// Matrices and vectors are filled serially while loading, so every page ends
+// up on one node. To move them, the whole pages of each array are released
+// with madvise(MADV_DONTNEED) (their next write maps a fresh zero page) and
+// the saved contents are written back by the thread that will read them in
+// the kernel. This needs a temporary copy of each array, but no change to
+// the vector types used by the kernels.
+
+inline void numa_release_pages(void* p, size_t bytes) {
+#ifdef __linux__
+    const size_t page   = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin  = (reinterpret_cast<size_t>(p) + page - 1) / page * page;
+    const size_t end    = (reinterpret_cast<size_t>(p) + bytes) / page * page;
+    if (end > begin) {
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+    }
+#else
+    (void)p;
+    (void)bytes;
+#endif
+}
+
+// Re-place A, v and c so that row i of A (row_ptr[i], its col_ind/values
+// entries), c[i] and v[i] live on the node of the thread that computes row
+// i: rows are split by part (balanced / merge) or, if part is null, by the
+// same schedule(runtime) loop as spmv_csr_parallel.
+template <typename V, typename P, typename I, typename X>
+void numa_first_touch(BasicCsrMatrix<V, P, I>& A, const RowPartition* part, int nthreads,
+                      std::vector<X>& v, std::vector<X>& c) {
+    const std::vector<P> row_ptr(A.row_ptr);
+    const std::vector<I> col_ind(A.col_ind);
+    const std::vector<V> values(A.values);
+    const std::vector<X> v_saved(v);
+
+    numa_release_pages(A.row_ptr.data(), A.row_ptr.size() * sizeof(P));
+    numa_release_pages(A.col_ind.data(), A.col_ind.size() * sizeof(I));
+    numa_release_pages(A.values.data(), A.values.size() * sizeof(V));
+    numa_release_pages(v.data(), v.size() * sizeof(X));
+    numa_release_pages(c.data(), c.size() * sizeof(X));
+
+    const I rows = A.rows;
+    const I cols = static_cast<I>(v.size());
+    auto touch_row = [&](I i) {
+        A.row_ptr[i] = row_ptr[i];
+        for (P j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+            A.col_ind[j] = col_ind[j];
+            A.values[j]  = values[j];
+        }
+        c[i] = 0;
+        if (i < cols) v[i] = v_saved[i];
+    };
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        if (part) {
+            // Every block, also those of threads the region did not get:
+            // their released pages would otherwise stay zero. The blocks are
+            // dealt out as in spmv_csr_balanced.
+            int tid = 0, nth = 1;
+#ifdef _OPENMP
+            tid = omp_get_thread_num();
+            nth = omp_get_num_threads();
+#endif
+            for (int t = tid; t < part->nparts; t += nth) {
+                for (int i = part->row_begin[t]; i < part->row_begin[t + 1]; ++i) {
+                    touch_row(i);
+                }
+            }
+        } else {
+            #pragma omp for schedule(runtime)
+            for (I i = 0; i < rows; ++i) {
+                touch_row(i);
+            }
+        }
+    }
+
+    A.row_ptr[rows] = row_ptr[rows];
+    for (I i = rows; i < cols; ++i) v[i] = v_saved[i];
+}
+
+#endif // NUMA_H
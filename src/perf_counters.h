@@ -0,0 +1,302 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Hardware counters around the timed kernel (perf_event_open)
+// ---------------------------------------------------------------------------
+//
+// Every thread of the benchmark opens its own set of counters on itself
+// (pid 0, any CPU, user space only), so loading, conversion and the
+// reference runs are never counted: the counters are created disabled and
+// only enabled around the timed calls. Counting follows the OS thread, so
+// per-thread values belong to the worker that ran the rows, whichever
+// kernel schedule was used.
+//
+// DRAM traffic is not a per-thread quantity. It is read from the Intel
+// uncore memory controllers (uncore_imc_*: cas_count_read / cas_count_write,
+// 64 bytes per CAS) when the kernel exposes them and perf_event_paranoid
+// allows system-wide counting; otherwise it is reported as unavailable.
+//
+// A counter that cannot be opened (no PMU in a VM, paranoid level, event not
+// supported) is simply left out. Counts are scaled by time_enabled /
+// time_running in case the kernel multiplexed them.
+
+enum PerfEvent {
+    PERF_EV_TASK_CLOCK,     // ns the thread was running
+    PERF_EV_CYCLES,
+    PERF_EV_INSTRUCTIONS,
+    PERF_EV_L1D_LOADS,
+    PERF_EV_L1D_MISSES,
+    PERF_EV_LLC_LOADS,
+    PERF_EV_LLC_MISSES,
+    PERF_EV_COUNT
+};
+
+inline const char* perf_event_label(int e) {
+    static const char* labels[PERF_EV_COUNT] = {
+        "task_ms", "cycles", "instructions", "l1d_loads", "l1d_misses", "llc_loads", "llc_misses"
+    };
+    return labels[e];
+}
+
+class PerfCounters {
+public:
+    explicit PerfCounters(int nthreads)
+        : nthreads_(nthreads), fds_((size_t)nthreads * PERF_EV_COUNT, -1) {}
+
+    ~PerfCounters() {
+        for (size_t k = 0; k < fds_.size(); ++k) close_fd(fds_[k]);
+        for (size_t k = 0; k < dram_fds_.size(); ++k) close_fd(dram_fds_[k]);
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    int nthreads() const { return nthreads_; }
+
+    // Open the per-thread counters of the calling thread as thread tid.
+    void open_current_thread(int tid) {
+#ifdef __linux__
+        for (int e = 0; e < PERF_EV_COUNT; ++e) {
+            perf_event_attr attr;
+            event_attr(e, attr);
+            fds_[(size_t)tid * PERF_EV_COUNT + e] = open_event(attr, 0, -1);
+        }
+#else
+        (void)tid;
+#endif
+    }
+
+    // Open the uncore memory-controller counters; false if there are none
+    // or they are not accessible.
+    bool open_dram() {
+#ifdef __linux__
+        const char* base = "/sys/bus/event_source/devices";
+        DIR* dir = opendir(base);
+        if (!dir) return false;
+        while (dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.compare(0, 10, "uncore_imc") != 0) continue;
+            const std::string dev = std::string(base) + "/" + name;
+            // One event per CPU of the cpumask: one CPU per socket (e.g.
+            // "0,18"), and each socket counts its own memory controllers
+            int type = 0;
+            if (!read_int(dev + "/type", type)) continue;
+            std::vector<int> cpus;
+            if (!read_cpu_list(dev + "/cpumask", cpus)) cpus.assign(1, 0);
+
+            const char* events[] = {"cas_count_read", "cas_count_write"};
+            for (int k = 0; k < 2; ++k) {
+                unsigned long long config = 0;
+                if (!read_event_config(dev + "/events/" + events[k], config)) continue;
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size        = sizeof(attr);
+                attr.type        = type;
+                attr.config      = config;
+                attr.disabled    = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                for (size_t c = 0; c < cpus.size(); ++c) {
+                    const int fd = open_event(attr, -1, cpus[c]);
+                    if (fd >= 0) dram_fds_.push_back(fd);
+                }
+            }
+        }
+        closedir(dir);
+#endif
+        return !dram_fds_.empty();
+    }
+
+    bool available(int e) const {
+        for (int t = 0; t < nthreads_; ++t) {
+            if (fds_[(size_t)t * PERF_EV_COUNT + e] >= 0) return true;
+        }
+        return false;
+    }
+
+    bool any_available() const {
+        for (int e = 0; e < PERF_EV_COUNT; ++e) {
+            if (available(e)) return true;
+        }
+        return false;
+    }
+
+    bool dram_available() const { return !dram_fds_.empty(); }
+
+    // Counters accumulate over every enable() / disable() window.
+    void enable()  { set_enabled(true); }
+    void disable() { set_enabled(false); }
+
+    // Scaled count of event e on thread tid (task clock in ms), 0 if the
+    // counter is not available.
+    double value(int tid, int e) const {
+        const double v = read_scaled(fds_[(size_t)tid * PERF_EV_COUNT + e]);
+        return e == PERF_EV_TASK_CLOCK ? v * 1.0e-6 : v;
+    }
+
+    double total(int e) const {
+        double sum = 0.0;
+        for (int t = 0; t < nthreads_; ++t) sum += value(t, e);
+        return sum;
+    }
+
+    // Bytes read + written by the memory controllers.
+    double dram_bytes() const {
+        double cas = 0.0;
+        for (size_t k = 0; k < dram_fds_.size(); ++k) cas += read_scaled(dram_fds_[k]);
+        return 64.0 * cas;
+    }
+
+private:
+#ifdef __linux__
+    static void event_attr(int e, perf_event_attr& attr) {
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const unsigned long long read_access = (unsigned long long)PERF_COUNT_HW_CACHE_OP_READ << 8;
+        const unsigned long long miss   = (unsigned long long)PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        const unsigned long long access = (unsigned long long)PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16;
+        switch (e) {
+            case PERF_EV_TASK_CLOCK:
+                attr.type   = PERF_TYPE_SOFTWARE;
+                attr.config = PERF_COUNT_SW_TASK_CLOCK;
+                break;
+            case PERF_EV_CYCLES:
+                attr.type   = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case PERF_EV_INSTRUCTIONS:
+                attr.type   = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case PERF_EV_L1D_LOADS:
+                attr.type   = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | read_access | access;
+                break;
+            case PERF_EV_L1D_MISSES:
+                attr.type   = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | read_access | miss;
+                break;
+            case PERF_EV_LLC_LOADS:
+                attr.type   = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_LL | read_access | access;
+                break;
+            default:
+                attr.type   = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_LL | read_access | miss;
+                break;
+        }
+    }
+
+    static int open_event(perf_event_attr& attr, int pid, int cpu) {
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, pid, cpu, -1, 0));
+    }
+
+    static bool read_int(const std::string& path, int& out) {
+        FILE* f = std::fopen(path.c_str(), "r");
+        if (!f) return false;
+        const bool ok = std::fscanf(f, "%d", &out) == 1;
+        std::fclose(f);
+        return ok;
+    }
+
+    // CPU list of a sysfs cpumask file: "0,18" or ranges such as "0-3,18"
+    static bool read_cpu_list(const std::string& path, std::vector<int>& cpus) {
+        FILE* f = std::fopen(path.c_str(), "r");
+        if (!f) return false;
+        char text[1024] = {0};
+        const bool ok = std::fgets(text, sizeof(text), f) != NULL;
+        std::fclose(f);
+        if (!ok) return false;
+
+        cpus.clear();
+        for (char* field = std::strtok(text, ",\n"); field; field = std::strtok(NULL, ",\n")) {
+            int first = 0, last = 0;
+            const int n = std::sscanf(field, "%d-%d", &first, &last);
+            if (n < 1) continue;
+            if (n == 1) last = first;
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+        return !cpus.empty();
+    }
+
+    // "event=0x04,umask=0x03" -> event | umask << 8 (the uncore IMC format)
+    static bool read_event_config(const std::string& path, unsigned long long& config) {
+        FILE* f = std::fopen(path.c_str(), "r");
+        if (!f) return false;
+        char text[256] = {0};
+        const bool ok = std::fgets(text, sizeof(text), f) != NULL;
+        std::fclose(f);
+        if (!ok) return false;
+
+        config = 0;
+        bool have_event = false;
+        for (char* field = std::strtok(text, ",\n"); field; field = std::strtok(NULL, ",\n")) {
+            unsigned long long value = 0;
+            if (std::sscanf(field, "event=%llx", &value) == 1) {
+                config |= value;
+                have_event = true;
+            } else if (std::sscanf(field, "umask=%llx", &value) == 1) {
+                config |= value << 8;
+            }
+        }
+        return have_event;
+    }
+#endif
+
+    static void close_fd(int fd) {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#else
+        (void)fd;
+#endif
+    }
+
+    void set_enabled(bool on) {
+#ifdef __linux__
+        const unsigned long request = on ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE;
+        for (size_t k = 0; k < fds_.size(); ++k) {
+            if (fds_[k] >= 0) ioctl(fds_[k], request, 0);
+        }
+        for (size_t k = 0; k < dram_fds_.size(); ++k) ioctl(dram_fds_[k], request, 0);
+#else
+        (void)on;
+#endif
+    }
+
+    static double read_scaled(int fd) {
+#ifdef __linux__
+        if (fd < 0) return 0.0;
+        unsigned long long data[3] = {0, 0, 0};   // value, time enabled, time running
+        if (read(fd, data, sizeof(data)) != (ssize_t)sizeof(data)) return 0.0;
+        if (data[2] == 0) return 0.0;
+        return (double)data[0] * ((double)data[1] / (double)data[2]);
+#else
+        (void)fd;
+        return 0.0;
+#endif
+    }
+
+    int nthreads_;
+    std::vector<int> fds_;         // nthreads * PERF_EV_COUNT, -1 = not available
+    std::vector<int> dram_fds_;
+};
+
+#endif // PERF_COUNTERS_H
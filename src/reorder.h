@@ -0,0 +1,250 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef SPMV_HAVE_METIS
+#include <metis.h>
+#endif
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// Symmetric reordering of square matrices
+// ---------------------------------------------------------------------------
+//
+// An ordering is a permutation perm with perm[new] = old; the reordered
+// matrix is B = P A P^T, i.e. row k of B is row perm[k] of A with every
+// column j renumbered to iperm[j]. Vectors follow the same rule:
+// v_new[k] = v[perm[k]], and a result is un-permuted with c[perm[k]] = c_new[k].
+
+// Bandwidth max |i - j| and (lower) profile sum_i (i - min_j col(i, j)).
+inline void csr_bandwidth_profile(const CsrMatrix& A, long long& bandwidth, long long& profile) {
+    long long bw = 0, prof = 0;
+    #pragma omp parallel for schedule(static) reduction(max:bw) reduction(+:prof) num_threads(io_num_threads())
+    for (int i = 0; i < A.rows; ++i) {
+        int lo = i;
+        for (int j = A.row_ptr[i]; j < A.row_ptr[i + 1]; ++j) {
+            const int col = A.col_ind[j];
+            bw = std::max(bw, (long long)std::abs(i - col));
+            lo = std::min(lo, col);
+        }
+        prof += i - lo;
+    }
+    bandwidth = bw;
+    profile   = prof;
+}
+
+// Adjacency of the symmetrised pattern A + A^T without the diagonal and
+// without duplicates (the graph both orderings work on).
+inline void csr_symmetric_graph(const CsrMatrix& A, std::vector<int>& adj_ptr,
+                                std::vector<int>& adj) {
+    const int n = A.rows;
+    adj_ptr.assign(n + 1, 0);
+    for (int i = 0; i < n; ++i) {
+        for (int j = A.row_ptr[i]; j < A.row_ptr[i + 1]; ++j) {
+            const int col = A.col_ind[j];
+            if (col == i) continue;
+            ++adj_ptr[i + 1];
+            ++adj_ptr[col + 1];
+        }
+    }
+    csr_prefix_sum(adj_ptr);
+
+    adj.resize(adj_ptr[n]);
+    std::vector<int> next(adj_ptr.begin(), adj_ptr.end() - 1);
+    for (int i = 0; i < n; ++i) {
+        for (int j = A.row_ptr[i]; j < A.row_ptr[i + 1]; ++j) {
+            const int col = A.col_ind[j];
+            if (col == i) continue;
+            adj[next[i]++]   = col;
+            adj[next[col]++] = i;
+        }
+    }
+
+    // Sort and deduplicate every list, then compact
+    int out = 0;
+    for (int i = 0; i < n; ++i) {
+        const int begin = adj_ptr[i];
+        const int end   = adj_ptr[i + 1];
+        std::sort(adj.begin() + begin, adj.begin() + end);
+        adj_ptr[i] = out;
+        for (int j = begin; j < end; ++j) {
+            if (j == begin || adj[j] != adj[j - 1]) adj[out++] = adj[j];
+        }
+    }
+    adj_ptr[n] = out;
+    adj.resize(out);
+}
+
+// Breadth-first search from root over the unvisited vertices of its
+// component. Vertices are appended to order in visiting order, neighbours by
+// increasing degree (Cuthill-McKee order); returns the depth of the last
+// level.
+inline int rcm_bfs(const std::vector<int>& adj_ptr, const std::vector<int>& adj, int root,
+                   std::vector<int>& level, std::vector<int>& order, std::vector<int>& scratch) {
+    const size_t first = order.size();
+    level[root] = 0;
+    order.push_back(root);
+    int depth = 0;
+    for (size_t head = first; head < order.size(); ++head) {
+        const int u = order[head];
+        scratch.clear();
+        for (int j = adj_ptr[u]; j < adj_ptr[u + 1]; ++j) {
+            if (level[adj[j]] < 0) {
+                level[adj[j]] = level[u] + 1;
+                scratch.push_back(adj[j]);
+            }
+        }
+        std::sort(scratch.begin(), scratch.end(), [&](int a, int b) {
+            const int da = adj_ptr[a + 1] - adj_ptr[a];
+            const int db = adj_ptr[b + 1] - adj_ptr[b];
+            return da != db ? da < db : a < b;
+        });
+        for (size_t k = 0; k < scratch.size(); ++k) {
+            order.push_back(scratch[k]);
+            depth = std::max(depth, level[u] + 1);
+        }
+    }
+    return depth;
+}
+
+// Reverse Cuthill-McKee. Every connected component starts from a
+// pseudo-peripheral vertex (George-Liu: repeat the BFS from a minimum-degree
+// vertex of the last level while the depth grows).
+inline void rcm_ordering(const CsrMatrix& A, std::vector<int>& perm) {
+    const int n = A.rows;
+    std::vector<int> adj_ptr, adj;
+    csr_symmetric_graph(A, adj_ptr, adj);
+
+    std::vector<int> level(n, -1), scratch, trial;
+    std::vector<char> done(n, 0);
+    perm.clear();
+    perm.reserve(n);
+
+    // Components are seeded in order of increasing degree
+    std::vector<int> seeds(n);
+    for (int i = 0; i < n; ++i) seeds[i] = i;
+    std::stable_sort(seeds.begin(), seeds.end(), [&](int a, int b) {
+        return adj_ptr[a + 1] - adj_ptr[a] < adj_ptr[b + 1] - adj_ptr[b];
+    });
+
+    for (int s = 0; s < n; ++s) {
+        int root = seeds[s];
+        if (done[root]) continue;
+
+        int depth = -1, best_root = root;
+        for (int iter = 0; iter < 8; ++iter) {
+            trial.clear();
+            const int d = rcm_bfs(adj_ptr, adj, root, level, trial, scratch);
+
+            // Minimum-degree vertex of the last level
+            int next = root, best_deg = -1;
+            for (size_t k = 0; k < trial.size(); ++k) {
+                const int u   = trial[k];
+                const int deg = adj_ptr[u + 1] - adj_ptr[u];
+                if (level[u] == d && (best_deg < 0 || deg < best_deg)) {
+                    next = u;
+                    best_deg = deg;
+                }
+            }
+            for (size_t k = 0; k < trial.size(); ++k) level[trial[k]] = -1;
+
+            if (d <= depth) break;
+            depth = d;
+            best_root = root;
+            if (next == root) break;
+            root = next;
+        }
+        root = best_root;
+
+        const size_t first = perm.size();
+        rcm_bfs(adj_ptr, adj, root, level, perm, scratch);
+        for (size_t k = first; k < perm.size(); ++k) done[perm[k]] = 1;
+    }
+
+    std::reverse(perm.begin(), perm.end());
+}
+
+// Graph-partition ordering: METIS k-way partition of the symmetrised graph
+// into nparts parts, rows numbered part by part (original order inside a
+// part). Returns false when built without METIS (-DSPMV_HAVE_METIS -lmetis).
+inline bool metis_ordering(const CsrMatrix& A, int nparts, std::vector<int>& perm) {
+#ifdef SPMV_HAVE_METIS
+    const int n = A.rows;
+    std::vector<int> adj_ptr, adj;
+    csr_symmetric_graph(A, adj_ptr, adj);
+
+    std::vector<idx_t> xadj(adj_ptr.begin(), adj_ptr.end());
+    std::vector<idx_t> adjncy(adj.begin(), adj.end());
+    std::vector<idx_t> part(n, 0);
+    idx_t nvtxs = n, ncon = 1, np = std::max(1, nparts), objval = 0;
+    if (np > 1 && METIS_PartGraphKway(&nvtxs, &ncon, xadj.data(), adjncy.data(), NULL, NULL,
+                                      NULL, &np, NULL, NULL, NULL, &objval,
+                                      part.data()) != METIS_OK) {
+        std::cerr << "Error: METIS_PartGraphKway failed.\n";
+        return false;
+    }
+
+    perm.resize(n);
+    for (int i = 0; i < n; ++i) perm[i] = i;
+    std::stable_sort(perm.begin(), perm.end(), [&](int a, int b) { return part[a] < part[b]; });
+    return true;
+#else
+    (void)A;
+    (void)nparts;
+    (void)perm;
+    std::cerr << "Error: built without METIS support (compile with -DSPMV_HAVE_METIS -lmetis).\n";
+    return false;
+#endif
+}
+
+// B = P A P^T for perm[new] = old.
+inline void csr_permute_symmetric(const CsrMatrix& A, const std::vector<int>& perm,
+                                  CsrMatrix& B) {
+    const int n = A.rows;
+    std::vector<int> iperm(n);
+    for (int k = 0; k < n; ++k) iperm[perm[k]] = k;
+
+    B.rows      = A.rows;
+    B.cols      = A.cols;
+    B.nnz       = A.nnz;
+    B.symmetric = A.symmetric;
+    B.row_ptr.assign(n + 1, 0);
+    for (int k = 0; k < n; ++k) {
+        B.row_ptr[k + 1] = A.row_ptr[perm[k] + 1] - A.row_ptr[perm[k]];
+    }
+    csr_prefix_sum(B.row_ptr);
+    B.col_ind.resize(A.nnz);
+    B.values.resize(A.nnz);
+
+    #pragma omp parallel for schedule(dynamic, 1024) num_threads(io_num_threads())
+    for (int k = 0; k < n; ++k) {
+        int out = B.row_ptr[k];
+        for (int j = A.row_ptr[perm[k]]; j < A.row_ptr[perm[k] + 1]; ++j, ++out) {
+            B.col_ind[out] = iperm[A.col_ind[j]];
+            B.values[out]  = A.values[j];
+        }
+    }
+    csr_sort_rows(B);
+}
+
+// Permute a vector (or a row-major block with width entries per row) into
+// the new order, x_new[k] = x[perm[k]], or back with inverse = true.
+template <typename T>
+inline void permute_rows(std::vector<T>& x, const std::vector<int>& perm, int width,
+                         bool inverse) {
+    const std::vector<T> src(x);
+    const int n = static_cast<int>(perm.size());
+    #pragma omp parallel for schedule(static) num_threads(io_num_threads())
+    for (int k = 0; k < n; ++k) {
+        const size_t to   = (size_t)(inverse ? perm[k] : k) * width;
+        const size_t from = (size_t)(inverse ? k : perm[k]) * width;
+        std::copy(src.begin() + from, src.begin() + from + width, x.begin() + to);
+    }
+}
+
+#endif // REORDER_H
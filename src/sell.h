@@ -0,0 +1,316 @@
+#ifndef SELL_H
+#define SELL_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <climits>
+
+#include <immintrin.h>
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// SELL-C-sigma (sliced ELLPACK) storage
+// ---------------------------------------------------------------------------
+//
+// Rows are sorted by decreasing length inside windows of sigma rows, then
+// packed into chunks of C consecutive (sorted) rows. A chunk is stored
+// column-major and padded to its longest row, so entry k of the C rows of a
+// chunk are contiguous and one SIMD lane handles one row:
+//
+//   element (r, k) of chunk ch  ->  chunk_ptr[ch] + k * C + r
+//
+// Padding entries have value 0 and column 0, so they can be gathered
+// without branches. perm maps a sorted row slot back to its original row
+// (-1 for the padding rows of the last chunk).
+
+struct SellCSigmaMatrix {
+    int rows  = 0;
+    int cols  = 0;
+    int nnz   = 0;
+    int C     = 0;
+    int sigma = 0;
+    int num_chunks = 0;
+    std::vector<int> chunk_ptr;   // num_chunks + 1 offsets into col_ind/values
+    std::vector<int> chunk_len;   // padded row length of each chunk
+    std::vector<int> perm;        // num_chunks * C sorted slot -> original row
+    std::vector<int> col_ind;
+    std::vector<double> values;
+
+    long long stored() const { return chunk_ptr.empty() ? 0 : chunk_ptr.back(); }
+
+    // Extra stored entries relative to nnz (0.05 = 5% padding)
+    double padding_overhead() const {
+        return nnz > 0 ? double(stored() - nnz) / nnz : 0.0;
+    }
+};
+
+// Returns false if the padded chunks do not fit int offsets.
+inline bool build_sell_c_sigma(const CsrMatrix& A, int C, int sigma,
+                               SellCSigmaMatrix& S) {
+    const int* row_ptr = A.row_ptr.data();
+
+    S.rows  = A.rows;
+    S.cols  = A.cols;
+    S.nnz   = A.nnz;
+    S.C     = C;
+    S.sigma = std::max(1, sigma);
+    S.num_chunks = (A.rows + C - 1) / C;
+
+    // Sort rows by decreasing length inside every sigma window
+    S.perm.assign((size_t)S.num_chunks * C, -1);
+    std::iota(S.perm.begin(), S.perm.begin() + A.rows, 0);
+    const int nwindows = (A.rows + S.sigma - 1) / S.sigma;
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(io_num_threads())
+    for (int w = 0; w < nwindows; ++w) {
+        const int begin = w * S.sigma;
+        const int end   = std::min(A.rows, begin + S.sigma);
+        std::stable_sort(S.perm.begin() + begin, S.perm.begin() + end,
+                         [row_ptr](int a, int b) {
+                             return row_ptr[a + 1] - row_ptr[a] > row_ptr[b + 1] - row_ptr[b];
+                         });
+    }
+
+    // Chunk widths and offsets; the padding can take the stored entries
+    // past INT_MAX even when nnz fits
+    S.chunk_len.assign(S.num_chunks, 0);
+    S.chunk_ptr.assign(S.num_chunks + 1, 0);
+    long long offset = 0;
+    for (int ch = 0; ch < S.num_chunks; ++ch) {
+        int width = 0;
+        for (int r = 0; r < C; ++r) {
+            const int row = S.perm[(size_t)ch * C + r];
+            if (row >= 0) width = std::max(width, row_ptr[row + 1] - row_ptr[row]);
+        }
+        S.chunk_len[ch] = width;
+        offset += (long long)width * C;
+        if (offset > INT_MAX) {
+            std::cerr << "Error: SELL-" << C << "-" << S.sigma
+                      << " stores more than INT_MAX entries.\n";
+            return false;
+        }
+        S.chunk_ptr[ch + 1] = static_cast<int>(offset);
+    }
+
+    // Fill column-major chunks, padding with (col 0, value 0)
+    S.col_ind.assign(S.stored(), 0);
+    S.values.assign(S.stored(), 0.0);
+    #pragma omp parallel for schedule(dynamic, 64) num_threads(io_num_threads())
+    for (int ch = 0; ch < S.num_chunks; ++ch) {
+        const int base = S.chunk_ptr[ch];
+        for (int r = 0; r < C; ++r) {
+            const int row = S.perm[(size_t)ch * C + r];
+            if (row < 0) continue;
+            for (int j = row_ptr[row]; j < row_ptr[row + 1]; ++j) {
+                const int k = j - row_ptr[row];
+                S.col_ind[base + k * C + r] = A.col_ind[j];
+                S.values[base + k * C + r]  = A.values[j];
+            }
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+//
+// All kernels loop over chunks with schedule(runtime), so the OpenMP
+// schedule chosen on the command line applies to chunks of C rows. The
+// SIMD variants keep one accumulator lane per row and use gathers for
+// v_in[col]; they are compiled with target attributes and picked at run
+// time, so the binary still runs on CPUs without AVX2/AVX-512.
+
+enum SellIsa {
+    SELL_ISA_AUTO,
+    SELL_ISA_SCALAR,
+    SELL_ISA_AVX2,
+    SELL_ISA_AVX512
+};
+
+inline const char* sell_isa_name(SellIsa isa) {
+    switch (isa) {
+        case SELL_ISA_SCALAR: return "scalar";
+        case SELL_ISA_AVX2:   return "avx2";
+        case SELL_ISA_AVX512: return "avx512";
+        default:              return "auto";
+    }
+}
+
+// Inverse of sell_isa_name; false for an unknown name
+inline bool sell_isa_from_name(const std::string& name, SellIsa& isa) {
+    if (name == "auto") {
+        isa = SELL_ISA_AUTO;
+    } else if (name == "scalar") {
+        isa = SELL_ISA_SCALAR;
+    } else if (name == "avx2") {
+        isa = SELL_ISA_AVX2;
+    } else if (name == "avx512") {
+        isa = SELL_ISA_AVX512;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Scatter the C sorted-row results of a chunk back to their original rows.
+inline void sell_store_chunk(const SellCSigmaMatrix& S, int ch, const double* sums,
+                             double* c_out) {
+    const int* perm = S.perm.data() + (size_t)ch * S.C;
+    for (int r = 0; r < S.C; ++r) {
+        if (perm[r] >= 0) c_out[perm[r]] = sums[r];
+    }
+}
+
+// Portable kernel, any C.
+inline void spmv_sell_scalar(const SellCSigmaMatrix& S,
+                             const std::vector<double>& v,
+                             std::vector<double>& c) {
+    const int C          = S.C;
+    const int* col_ind   = S.col_ind.data();
+    const double* values = S.values.data();
+    const double* v_in   = v.data();
+    double* c_out        = c.data();
+
+    #pragma omp parallel
+    {
+        std::vector<double> sums(C);
+
+        #pragma omp for schedule(runtime)
+        for (int ch = 0; ch < S.num_chunks; ++ch) {
+            std::fill(sums.begin(), sums.end(), 0.0);
+            const int base = S.chunk_ptr[ch];
+            for (int k = 0; k < S.chunk_len[ch]; ++k) {
+                const int off = base + k * C;
+                for (int r = 0; r < C; ++r) {
+                    sums[r] += values[off + r] * v_in[col_ind[off + r]];
+                }
+            }
+            sell_store_chunk(S, ch, sums.data(), c_out);
+        }
+    }
+}
+
+// AVX2 + FMA: C / 4 accumulators of 4 doubles, 4-wide gathers.
+template <int C>
+__attribute__((target("avx2,fma")))
+void spmv_sell_avx2(const SellCSigmaMatrix& S,
+                    const std::vector<double>& v,
+                    std::vector<double>& c) {
+    static_assert(C % 4 == 0, "AVX2 SELL kernel needs C % 4 == 0");
+    const int* col_ind   = S.col_ind.data();
+    const double* values = S.values.data();
+    const double* v_in   = v.data();
+    double* c_out        = c.data();
+
+    // Masked gathers with an explicit (zero) source operand; the unmasked
+    // intrinsics leave their source undefined and trip -Wmaybe-uninitialized.
+    const __m256d all_lanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+    #pragma omp parallel for schedule(runtime)
+    for (int ch = 0; ch < S.num_chunks; ++ch) {
+        __m256d acc[C / 4];
+        for (int g = 0; g < C / 4; ++g) acc[g] = _mm256_setzero_pd();
+
+        const int base = S.chunk_ptr[ch];
+        for (int k = 0; k < S.chunk_len[ch]; ++k) {
+            const int off = base + k * C;
+            for (int g = 0; g < C / 4; ++g) {
+                const __m128i idx = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(col_ind + off + 4 * g));
+                const __m256d x   = _mm256_mask_i32gather_pd(
+                    _mm256_setzero_pd(), v_in, idx, all_lanes, 8);
+                const __m256d a   = _mm256_loadu_pd(values + off + 4 * g);
+                acc[g] = _mm256_fmadd_pd(a, x, acc[g]);
+            }
+        }
+
+        alignas(32) double sums[C];
+        for (int g = 0; g < C / 4; ++g) _mm256_store_pd(sums + 4 * g, acc[g]);
+        sell_store_chunk(S, ch, sums, c_out);
+    }
+}
+
+// AVX-512F: C / 8 accumulators of 8 doubles, 8-wide gathers.
+template <int C>
+__attribute__((target("avx512f")))
+void spmv_sell_avx512(const SellCSigmaMatrix& S,
+                      const std::vector<double>& v,
+                      std::vector<double>& c) {
+    static_assert(C % 8 == 0, "AVX-512 SELL kernel needs C % 8 == 0");
+    const int* col_ind   = S.col_ind.data();
+    const double* values = S.values.data();
+    const double* v_in   = v.data();
+    double* c_out        = c.data();
+
+    #pragma omp parallel for schedule(runtime)
+    for (int ch = 0; ch < S.num_chunks; ++ch) {
+        __m512d acc[C / 8];
+        for (int g = 0; g < C / 8; ++g) acc[g] = _mm512_setzero_pd();
+
+        const int base = S.chunk_ptr[ch];
+        for (int k = 0; k < S.chunk_len[ch]; ++k) {
+            const int off = base + k * C;
+            for (int g = 0; g < C / 8; ++g) {
+                const __m256i idx = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(col_ind + off + 8 * g));
+                const __m512d x   = _mm512_mask_i32gather_pd(
+                    _mm512_setzero_pd(), 0xFF, idx, v_in, 8);
+                const __m512d a   = _mm512_loadu_pd(values + off + 8 * g);
+                acc[g] = _mm512_fmadd_pd(a, x, acc[g]);
+            }
+        }
+
+        alignas(64) double sums[C];
+        for (int g = 0; g < C / 8; ++g) _mm512_store_pd(sums + 8 * g, acc[g]);
+        sell_store_chunk(S, ch, sums, c_out);
+    }
+}
+
+inline bool sell_cpu_has_avx2() {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+inline bool sell_cpu_has_avx512() {
+    return __builtin_cpu_supports("avx512f");
+}
+
+// Pick the widest ISA that the CPU supports and C allows. An explicit
+// request is honoured when possible and falls back to scalar otherwise.
+inline SellIsa sell_select_isa(int C, SellIsa requested) {
+    const bool c_avx512 = (C == 8 || C == 16 || C == 32);
+    const bool c_avx2   = (C == 4 || c_avx512);
+
+    if (requested == SELL_ISA_SCALAR) return SELL_ISA_SCALAR;
+    if (requested == SELL_ISA_AVX512 || requested == SELL_ISA_AUTO) {
+        if (c_avx512 && sell_cpu_has_avx512()) return SELL_ISA_AVX512;
+        if (requested == SELL_ISA_AVX512) return SELL_ISA_SCALAR;
+    }
+    if (c_avx2 && sell_cpu_has_avx2()) return SELL_ISA_AVX2;
+    return SELL_ISA_SCALAR;
+}
+
+inline void spmv_sell(const SellCSigmaMatrix& S, SellIsa isa,
+                      const std::vector<double>& v,
+                      std::vector<double>& c) {
+    if (isa == SELL_ISA_AVX512) {
+        switch (S.C) {
+            case 8:  spmv_sell_avx512<8>(S, v, c);  return;
+            case 16: spmv_sell_avx512<16>(S, v, c); return;
+            case 32: spmv_sell_avx512<32>(S, v, c); return;
+        }
+    } else if (isa == SELL_ISA_AVX2) {
+        switch (S.C) {
+            case 4:  spmv_sell_avx2<4>(S, v, c);  return;
+            case 8:  spmv_sell_avx2<8>(S, v, c);  return;
+            case 16: spmv_sell_avx2<16>(S, v, c); return;
+            case 32: spmv_sell_avx2<32>(S, v, c); return;
+        }
+    }
+    spmv_sell_scalar(S, v, c);
+}
+
+#endif // SELL_H
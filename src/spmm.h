@@ -0,0 +1,94 @@
+#ifndef SPMM_H
+#define SPMM_H
+
+#include <vector>
+#include <algorithm>
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// CSR x dense block (SpMM)
+// ---------------------------------------------------------------------------
+//
+// Y = A * X for k right-hand sides in one pass over the matrix. X (cols x k)
+// and Y (rows x k) are row-major, so row col of X is k contiguous doubles:
+//
+//   X[col * k + r]   entry col of input vector r
+//   Y[row * k + r]   entry row of output vector r
+//
+// Every nonzero is loaded once and applied to all k vectors, so values and
+// col_ind are streamed once instead of k times. The fixed-k kernels keep the
+// k sums of a row in registers and vectorise across k.
+
+template <int K>
+void spmm_csr_fixed(const CsrMatrix& A,
+                    const std::vector<double>& X,
+                    std::vector<double>& Y) {
+    const int* row_ptr   = A.row_ptr.data();
+    const int* col_ind   = A.col_ind.data();
+    const double* values = A.values.data();
+    const double* x_in   = X.data();
+    double* y_out        = Y.data();
+
+    const int rows = A.rows;
+
+    #pragma omp parallel for schedule(runtime)
+    for (int i = 0; i < rows; ++i) {
+        double sum[K];
+        for (int r = 0; r < K; ++r) sum[r] = 0.0;
+
+        for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+            const double a    = values[j];
+            const double* x_j = x_in + (size_t)col_ind[j] * K;
+            #pragma omp simd
+            for (int r = 0; r < K; ++r) {
+                sum[r] += a * x_j[r];
+            }
+        }
+
+        double* y_i = y_out + (size_t)i * K;
+        for (int r = 0; r < K; ++r) y_i[r] = sum[r];
+    }
+}
+
+// Any k (runtime loop bound, partial sums kept in Y).
+inline void spmm_csr_generic(const CsrMatrix& A, int k,
+                             const std::vector<double>& X,
+                             std::vector<double>& Y) {
+    const int* row_ptr   = A.row_ptr.data();
+    const int* col_ind   = A.col_ind.data();
+    const double* values = A.values.data();
+    const double* x_in   = X.data();
+    double* y_out        = Y.data();
+
+    const int rows = A.rows;
+
+    #pragma omp parallel for schedule(runtime)
+    for (int i = 0; i < rows; ++i) {
+        double* y_i = y_out + (size_t)i * k;
+        std::fill(y_i, y_i + k, 0.0);
+
+        for (int j = row_ptr[i]; j < row_ptr[i + 1]; ++j) {
+            const double a    = values[j];
+            const double* x_j = x_in + (size_t)col_ind[j] * k;
+            #pragma omp simd
+            for (int r = 0; r < k; ++r) {
+                y_i[r] += a * x_j[r];
+            }
+        }
+    }
+}
+
+inline void spmm_csr(const CsrMatrix& A, int k,
+                     const std::vector<double>& X,
+                     std::vector<double>& Y) {
+    switch (k) {
+        case 2:  spmm_csr_fixed<2>(A, X, Y);  return;
+        case 4:  spmm_csr_fixed<4>(A, X, Y);  return;
+        case 8:  spmm_csr_fixed<8>(A, X, Y);  return;
+        case 16: spmm_csr_fixed<16>(A, X, Y); return;
+    }
+    spmm_csr_generic(A, k, X, Y);
+}
+
+#endif // SPMM_H
@@ -0,0 +1,60 @@
+#ifndef SPMV_COMMON_H
+#define SPMV_COMMON_H
+
+#include <string>
+#include <vector>
+#include <random>
+#include <stdexcept>
+
+// ---------------------------------------------------------------------------
+// Helpers shared by the drivers
+// ---------------------------------------------------------------------------
+
+// Extract matrix name from full path
+// Example: "/home/.../bcsstk17/bcsstk17.mtx" -> "bcsstk17"
+inline std::string extract_matrix_name(const std::string& path) {
+    // Remove directory part
+    size_t pos = path.find_last_of("/\\");
+    std::string filename = (pos == std::string::npos) ? path : path.substr(pos + 1);
+
+    // Remove ".mtx" extension if present
+    const std::string ext = ".mtx";
+    if (filename.size() > ext.size() &&
+        filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0) {
+        filename.erase(filename.size() - ext.size(), ext.size());
+    }
+    return filename;
+}
+
+// Parse a strictly positive integer option value
+inline bool parse_positive(const std::string& text, int& out) {
+    try {
+        size_t pos = 0;
+        out = std::stoi(text, &pos);
+        return pos == text.size() && out > 0;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Parse a strictly positive floating-point option value
+inline bool parse_positive(const std::string& text, double& out) {
+    try {
+        size_t pos = 0;
+        out = std::stod(text, &pos);
+        return pos == text.size() && out > 0.0;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Random input vector in [-1000, 1000]; the same seed gives the same vector
+inline void fill_random_input(std::vector<double>& v, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1000.0, 1000.0);
+    for (size_t i = 0; i < v.size(); ++i) {
+        v[i] = dist(gen);
+    }
+}
+
+#endif // SPMV_COMMON_H
@@ -0,0 +1,135 @@
+#ifndef THREAD_STATS_H
+#define THREAD_STATS_H
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <new>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Per-thread timing of a parallel kernel (--thread-stats)
+// ---------------------------------------------------------------------------
+//
+// Every thread stamps the clock when it enters the parallel region, when it
+// runs out of rows (the worksharing loop is nowait) and when it leaves the
+// barrier that closes the region: busy time is the first interval, wait
+// time the second. Rows and nonzeros are those the schedule actually handed
+// to the thread. A stamp is one rdtsc (invariant TSC on current x86), so the
+// instrumentation costs a few cycles per thread and a counter per row;
+// elsewhere the stamps fall back to steady_clock.
+//
+// The imbalance factor of a call is max / mean busy time over the threads
+// that ran: 1 is perfect balance, nthreads means one thread did all the work.
+// Only the calls between enable() and disable() are recorded.
+
+inline unsigned long long thread_stats_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Ticks per millisecond, measured once against steady_clock over ~10 ms
+inline double thread_stats_ticks_per_ms() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double rate = []() {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const unsigned long long t0 = thread_stats_ticks();
+        double ms = 0.0;
+        while (ms < 10.0) {
+            ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+        return (thread_stats_ticks() - t0) / ms;
+    }();
+    return rate;
+#else
+    return 1.0e6;
+#endif
+}
+
+// Written by its thread once per call; one cache line each (64 bytes, and
+// ThreadStats places the slots on a 64-byte boundary), so neighbouring
+// threads do not share a line
+struct ThreadStatsSlot {
+    long long rows = 0;
+    long long nnz  = 0;
+    unsigned long long busy = 0;     // ticks
+    unsigned long long wait = 0;
+    char pad[64 - 4 * sizeof(long long)];
+};
+static_assert(sizeof(ThreadStatsSlot) == 64, "ThreadStatsSlot must be 64 bytes");
+
+class ThreadStats {
+public:
+    // The slots sit in a byte buffer with one spare line, aligned by hand
+    // (std::vector does not honour alignas in C++11)
+    explicit ThreadStats(int nthreads)
+        : nthreads_(nthreads), storage_((size_t)(nthreads + 1) * 64), rows_(nthreads, 0.0),
+          nnz_(nthreads, 0.0), busy_(nthreads, 0.0), wait_(nthreads, 0.0) {
+        unsigned char* p = storage_.data();
+        while (reinterpret_cast<size_t>(p) % 64 != 0) ++p;
+        slots_ = reinterpret_cast<ThreadStatsSlot*>(p);
+        for (int t = 0; t < nthreads_; ++t) new (slots_ + t) ThreadStatsSlot();
+    }
+
+    ThreadStats(const ThreadStats&) = delete;
+    ThreadStats& operator=(const ThreadStats&) = delete;
+
+    int nthreads() const { return nthreads_; }
+
+    void enable()  { recording_ = true; }
+    void disable() { recording_ = false; }
+
+    // Before a call: clear the slots (a thread may get no rows at all)
+    void begin_call() {
+        for (int t = 0; t < nthreads_; ++t) slots_[t] = ThreadStatsSlot();
+    }
+    ThreadStatsSlot& slot(int tid) { return slots_[tid]; }
+
+    // After a call: add the slots to the totals and record the imbalance
+    void end_call() {
+        if (!recording_) return;
+        // The mean is over the threads that ran: the region may have had
+        // fewer than nthreads_, whose slots stay zero
+        unsigned long long max_busy = 0, sum_busy = 0;
+        int ran = 0;
+        for (int t = 0; t < nthreads_; ++t) {
+            if (slots_[t].busy > 0 || slots_[t].rows > 0) ++ran;
+            rows_[t] += slots_[t].rows;
+            nnz_[t]  += slots_[t].nnz;
+            busy_[t] += slots_[t].busy;
+            wait_[t] += slots_[t].wait;
+            max_busy  = std::max(max_busy, slots_[t].busy);
+            sum_busy += slots_[t].busy;
+        }
+        imbalance_.push_back(sum_busy > 0 ? (double)max_busy * ran / sum_busy : 1.0);
+    }
+
+    int calls() const { return (int)imbalance_.size(); }
+    const std::vector<double>& imbalance() const { return imbalance_; }
+
+    // Per recorded call
+    double rows(int t) const    { return per_call(rows_[t]); }
+    double nnz(int t) const     { return per_call(nnz_[t]); }
+    double busy_ms(int t) const { return per_call(busy_[t]) / thread_stats_ticks_per_ms(); }
+    double wait_ms(int t) const { return per_call(wait_[t]) / thread_stats_ticks_per_ms(); }
+
+private:
+    double per_call(double total) const { return calls() > 0 ? total / calls() : 0.0; }
+
+    int nthreads_;
+    std::vector<unsigned char> storage_;
+    ThreadStatsSlot* slots_;
+    std::vector<double> rows_, nnz_, busy_, wait_;
+    std::vector<double> imbalance_;
+    bool recording_ = false;
+};
+
+#endif // THREAD_STATS_H
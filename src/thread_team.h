@@ -0,0 +1,182 @@
+#ifndef THREAD_TEAM_H
+#define THREAD_TEAM_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Persistent thread team
+// ---------------------------------------------------------------------------
+//
+// Every `#pragma omp parallel` wakes the team, runs the region and ends with
+// an implicit barrier. On small matrices (heart2, olm2000) one SpMV takes a
+// few microseconds, so that fork/join is a large part of the measured time.
+// ThreadTeam starts nthreads - 1 worker threads once; the calling thread is
+// thread 0. run(f) publishes f by bumping a generation counter, every thread
+// calls f(tid), and a sense-reversing spin barrier ends the call. Between
+// calls the workers spin on the counter (yielding after a while), so a call
+// costs one flag write and one barrier instead of a team wake-up.
+//
+// Code written against the team policy (size(), run(f), barrier(tid),
+// active()) runs either on a ThreadTeam or on an OpenMP parallel region
+// (OmpTeam), e.g. the Krylov solvers in krylov.h. active() is the number of
+// threads inside a run() call: always size() for a ThreadTeam, possibly
+// fewer for an OmpTeam, whose region the runtime may shrink
+// (OMP_THREAD_LIMIT, OMP_DYNAMIC).
+
+// Busy-wait hint; after SPIN_LIMIT polls the waiter yields its CPU so an
+// oversubscribed run still makes progress.
+inline void spin_pause(int& polls) {
+    const int SPIN_LIMIT = 4096;
+    if (++polls < SPIN_LIMIT) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+// Centralised sense-reversing barrier: the last thread to arrive resets the
+// counter and flips the global sense, the others spin on it. Every thread
+// keeps its own sense in a padded slot, so the barrier can be reused back to
+// back.
+class SpinBarrier {
+public:
+    explicit SpinBarrier(int nthreads)
+        : nthreads_(nthreads), count_(nthreads), sense_(0), local_(nthreads) {}
+
+    void wait(int tid) {
+        const int my_sense = local_[tid].sense = !local_[tid].sense;
+        if (count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            count_.store(nthreads_, std::memory_order_relaxed);
+            sense_.store(my_sense, std::memory_order_release);
+        } else {
+            int polls = 0;
+            while (sense_.load(std::memory_order_acquire) != my_sense) spin_pause(polls);
+        }
+    }
+
+private:
+    struct LocalSense {
+        int sense = 0;
+        char pad[64 - sizeof(int)];
+    };
+
+    // Counter and sense on separate cache lines (plain padding rather than
+    // alignas, so the team can be heap-allocated in C++11)
+    const int nthreads_;
+    char pad0_[64];
+    std::atomic<int> count_;
+    char pad1_[64];
+    std::atomic<int> sense_;
+    char pad2_[64];
+    std::vector<LocalSense> local_;
+};
+
+class ThreadTeam {
+public:
+    explicit ThreadTeam(int nthreads)
+        : nthreads_(nthreads < 1 ? 1 : nthreads), barrier_(nthreads_),
+          generation_(0), stop_(false), task_(nullptr), context_(nullptr) {
+        for (int tid = 1; tid < nthreads_; ++tid) {
+            workers_.push_back(std::thread(&ThreadTeam::worker_loop, this, tid));
+        }
+    }
+
+    ~ThreadTeam() {
+        stop_.store(true, std::memory_order_relaxed);
+        generation_.fetch_add(1, std::memory_order_release);
+        for (size_t k = 0; k < workers_.size(); ++k) workers_[k].join();
+    }
+
+    ThreadTeam(const ThreadTeam&) = delete;
+    ThreadTeam& operator=(const ThreadTeam&) = delete;
+
+    int size() const { return nthreads_; }
+    int active() const { return nthreads_; }
+
+    // Run f(tid) on every thread of the team; returns when all are done.
+    template <typename F>
+    void run(const F& f) {
+        task_    = &invoke<F>;
+        context_ = &f;
+        generation_.fetch_add(1, std::memory_order_release);
+        f(0);
+        barrier_.wait(0);
+    }
+
+    // Barrier among the threads of a run() call.
+    void barrier(int tid) { barrier_.wait(tid); }
+
+private:
+    template <typename F>
+    static void invoke(const void* context, int tid) {
+        (*static_cast<const F*>(context))(tid);
+    }
+
+    void worker_loop(int tid) {
+        unsigned seen = 0;
+        for (;;) {
+            int polls = 0;
+            unsigned gen;
+            while ((gen = generation_.load(std::memory_order_acquire)) == seen) {
+                spin_pause(polls);
+            }
+            seen = gen;
+            if (stop_.load(std::memory_order_relaxed)) return;
+            task_(context_, tid);
+            barrier_.wait(tid);
+        }
+    }
+
+    const int nthreads_;
+    SpinBarrier barrier_;
+    char pad_[64];
+    std::atomic<unsigned> generation_;
+    std::atomic<bool> stop_;
+    void (*task_)(const void*, int);
+    const void* context_;
+    std::vector<std::thread> workers_;
+};
+
+// The same policy on a fresh OpenMP parallel region per run() call.
+class OmpTeam {
+public:
+    explicit OmpTeam(int nthreads) : nthreads_(nthreads), active_(nthreads) {}
+
+    int size() const { return nthreads_; }
+    int active() const { return active_; }
+
+    // The region may get fewer than size() threads; active() tells f how
+    // many (set before any thread calls f)
+    template <typename F>
+    void run(const F& f) {
+        #pragma omp parallel num_threads(nthreads_)
+        {
+#ifdef _OPENMP
+            #pragma omp single
+            active_ = omp_get_num_threads();
+            f(omp_get_thread_num());
+#else
+            active_ = 1;
+            f(0);
+#endif
+        }
+    }
+
+    void barrier(int) {
+        #pragma omp barrier
+    }
+
+private:
+    int nthreads_;
+    int active_;
+};
+
+#endif // THREAD_TEAM_H
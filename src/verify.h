@@ -0,0 +1,100 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// Result verification
+// ---------------------------------------------------------------------------
+//
+// The result of the timed kernel is checked after the timed calls against a
+// sequential CSR reference with compensated (Kahan) summation per row, so
+// the reference itself is accurate to about one rounding of the exact dot
+// product, whatever the row length. The error of row i is scaled by
+// sum_j |a_ij v_j| rather than by |c_i|: that is the quantity the rounding
+// error of any summation order is proportional to, so rows with
+// cancellation do not produce false failures.
+//
+// With k > 1 the vectors are row-major blocks (v: cols x k, c: rows x k) as
+// in spmm.h.
+
+// Default tolerances on the scaled error of fp64 kernels and of the
+// reduced-precision (fp32 values or accumulation) kernels
+static const double VERIFY_TOL_FP64 = 1e-10;
+static const double VERIFY_TOL_FP32 = 1e-4;
+
+// c = A v with Kahan summation; scale_i = sum_j |a_ij v_j|. A must have
+// general storage (expand a half-stored symmetric matrix first).
+template <typename P, typename I>
+void spmv_csr_kahan(const BasicCsrMatrix<double, P, I>& A, const std::vector<double>& v, int k,
+                    std::vector<double>& c, std::vector<double>& scale) {
+    c.assign((size_t)A.rows * k, 0.0);
+    scale.assign((size_t)A.rows * k, 0.0);
+    for (I i = 0; i < A.rows; ++i) {
+        for (int q = 0; q < k; ++q) {
+            double sum = 0.0, compensation = 0.0, magnitude = 0.0;
+            for (P j = A.row_ptr[i]; j < A.row_ptr[i + 1]; ++j) {
+                const double term = A.values[j] * v[(size_t)A.col_ind[j] * k + q];
+                const double y = term - compensation;
+                const double t = sum + y;
+                compensation = (t - sum) - y;
+                sum = t;
+                magnitude += std::fabs(term);
+            }
+            c[(size_t)i * k + q]     = sum;
+            scale[(size_t)i * k + q] = magnitude;
+        }
+    }
+}
+
+struct VerifyResult {
+    double max_error = 0.0;      // max_i |c_i - ref_i| / sum_j |a_ij v_j|
+    long long worst  = -1;       // entry with that error
+    long long failed = 0;        // entries above the tolerance
+    bool ok = true;
+};
+
+// Compare c with the Kahan reference of A v (k vectors). Entries whose
+// scale is zero must match exactly (their row has no contributing term).
+template <typename P, typename I, typename X>
+VerifyResult verify_spmv(const BasicCsrMatrix<double, P, I>& A, const std::vector<double>& v,
+                         int k, const std::vector<X>& c, double tol) {
+    std::vector<double> ref, scale;
+    spmv_csr_kahan(A, v, k, ref, scale);
+
+    VerifyResult r;
+    for (size_t e = 0; e < ref.size(); ++e) {
+        const double diff = std::fabs(static_cast<double>(c[e]) - ref[e]);
+        const double err  = scale[e] > 0.0 ? diff / scale[e] : (diff > 0.0 ? HUGE_VAL : 0.0);
+        if (!(err <= tol)) ++r.failed;     // also catches NaN
+        if (!(err <= r.max_error)) {
+            r.max_error = err;
+            r.worst     = (long long)e;
+        }
+    }
+    r.ok = r.failed == 0;
+    return r;
+}
+
+// One stderr line per check; false (after an error line) if it failed
+inline bool report_verify(const std::string& label, const VerifyResult& r, double tol, int k) {
+    std::cerr << "Verify " << label << ": max scaled error " << r.max_error << " (tolerance "
+              << tol << ") vs Kahan CSR reference";
+    if (r.ok) {
+        std::cerr << ": ok\n";
+        return true;
+    }
+    std::cerr << "\nError: verification failed for " << label << ": " << r.failed
+              << " entries above the tolerance, worst at row " << r.worst / k;
+    if (k > 1) std::cerr << " vector " << r.worst % k;
+    std::cerr << "\n";
+    return false;
+}
+
+#endif // VERIFY_H
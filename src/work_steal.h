@@ -0,0 +1,137 @@
+#ifndef WORK_STEAL_H
+#define WORK_STEAL_H
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "csr_matrix.h"
+
+// ---------------------------------------------------------------------------
+// Work-stealing row scheduler
+// ---------------------------------------------------------------------------
+//
+// Every thread owns a range of rows [begin, end), packed into one 64-bit
+// atomic word so it can be split with a single compare-and-swap:
+//
+//   owner:  takes chunk rows from the front  [begin, begin + chunk)
+//   thief:  takes the back half              [mid, end), victim keeps [begin, mid)
+//
+// Before every call the ranges are reset to the nnz-balanced RowPartition,
+// so a regular matrix runs like `balanced` and only threads that run dry
+// touch another thread's word. A thread whose own range is empty walks the
+// other threads once, starting after itself; a stolen range becomes its own
+// range (and can be stolen from again). When no range with two or more rows
+// is left the thread stops: a remaining single row belongs to a thread that
+// is still working on its range.
+//
+// The region may get fewer threads than ranges (OMP_THREAD_LIMIT,
+// OMP_DYNAMIC). The ranges of the missing ids then have no owner, so each
+// present thread tid also owns the ranges tid + team, tid + 2 team, ... and
+// empties them before it steals; the stop rule holds again.
+
+class WorkStealRows {
+public:
+    WorkStealRows() : nthreads_(0), chunk_(1) {}
+
+    // Initial ranges from part; the owner takes chunk rows per grab.
+    void init(const RowPartition& part, int chunk) {
+        nthreads_ = part.nparts;
+        chunk_    = std::max(1, chunk);
+        initial_  = part.row_begin;
+        slots_    = std::vector<Slot>(nthreads_);
+    }
+
+    int nthreads() const { return nthreads_; }
+
+    // Restore the initial ranges; call outside the parallel region.
+    void reset() {
+        for (int t = 0; t < nthreads_; ++t) {
+            slots_[t].range.store(pack(initial_[t], initial_[t + 1]), std::memory_order_relaxed);
+        }
+    }
+
+    // Next block of rows for thread tid of a team of team threads; false
+    // when the call is done.
+    bool next(int tid, int team, int& begin, int& end) {
+        for (int owned = tid; owned < nthreads_; owned += team) {
+            if (pop(owned, begin, end)) return true;
+        }
+        for (int k = 1; k < nthreads_; ++k) {
+            const int victim = (tid + k) % nthreads_;
+            if (steal(tid, victim)) {
+                ++slots_[tid].steals;
+                return pop(tid, begin, end);
+            }
+        }
+        return false;
+    }
+
+    // Successful steals since the last call to take_steals().
+    long long take_steals() {
+        long long total = 0;
+        for (int t = 0; t < nthreads_; ++t) {
+            total += slots_[t].steals;
+            slots_[t].steals = 0;
+        }
+        return total;
+    }
+
+private:
+    // One range per cache line; steals is only written by its owner.
+    struct Slot {
+        std::atomic<uint64_t> range;
+        long long steals;
+        char pad[64 - sizeof(std::atomic<uint64_t>) - sizeof(long long)];
+
+        Slot() : range(0), steals(0) {}
+        Slot(const Slot&) : range(0), steals(0) {}
+    };
+
+    static uint64_t pack(int begin, int end) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(begin)) << 32) |
+               static_cast<uint32_t>(end);
+    }
+    static int range_begin(uint64_t r) { return static_cast<int>(r >> 32); }
+    static int range_end(uint64_t r)   { return static_cast<int>(r & 0xFFFFFFFFu); }
+
+    bool pop(int tid, int& begin, int& end) {
+        std::atomic<uint64_t>& range = slots_[tid].range;
+        uint64_t r = range.load(std::memory_order_acquire);
+        for (;;) {
+            const int b = range_begin(r);
+            const int e = range_end(r);
+            if (b >= e) return false;
+            const int nb = std::min(e, b + chunk_);
+            if (range.compare_exchange_weak(r, pack(nb, e), std::memory_order_acq_rel)) {
+                begin = b;
+                end   = nb;
+                return true;
+            }
+        }
+    }
+
+    // Move the back half of the victim's range into the (empty) range of tid.
+    bool steal(int tid, int victim) {
+        std::atomic<uint64_t>& range = slots_[victim].range;
+        uint64_t r = range.load(std::memory_order_acquire);
+        for (;;) {
+            const int b = range_begin(r);
+            const int e = range_end(r);
+            if (e - b < 2) return false;
+            const int mid = b + (e - b) / 2;
+            if (range.compare_exchange_weak(r, pack(b, mid), std::memory_order_acq_rel)) {
+                slots_[tid].range.store(pack(mid, e), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    int nthreads_;
+    int chunk_;
+    std::vector<int> initial_;
+    std::vector<Slot> slots_;
+};
+
+#endif // WORK_STEAL_H